@@ -0,0 +1,93 @@
+#include <ContentHash/ContentHash.h>
+
+#define PRIME64_1 0x9E3779B185EBCA87ull
+#define PRIME64_2 0xC2B2AE3D27D4EB4Full
+#define PRIME64_3 0x165667B19E3779F9ull
+#define PRIME64_4 0x85EBCA77C2B2AE63ull
+#define PRIME64_5 0x27D4EB2F165667C5ull
+
+static inline uint64_t ev_contenthash_rotl(uint64_t x, uint32_t r)
+{
+  return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t ev_contenthash_read64(const uint8_t *p)
+{
+  uint64_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static inline uint32_t ev_contenthash_read32(const uint8_t *p)
+{
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static inline uint64_t ev_contenthash_round(uint64_t acc, uint64_t input)
+{
+  acc += input * PRIME64_2;
+  acc = ev_contenthash_rotl(acc, 31);
+  return acc * PRIME64_1;
+}
+
+static inline uint64_t ev_contenthash_mergeround(uint64_t acc, uint64_t val)
+{
+  acc ^= ev_contenthash_round(0, val);
+  return acc * PRIME64_1 + PRIME64_4;
+}
+
+uint64_t ev_contenthash_compute(const void *data, uint64_t size, uint64_t seed)
+{
+  const uint8_t *p = data;
+  const uint8_t *end = p + size;
+  uint64_t h;
+
+  if (size >= 32) {
+    uint64_t v1 = seed + PRIME64_1 + PRIME64_2;
+    uint64_t v2 = seed + PRIME64_2;
+    uint64_t v3 = seed;
+    uint64_t v4 = seed - PRIME64_1;
+
+    for (; p + 32 <= end; p += 32) {
+      v1 = ev_contenthash_round(v1, ev_contenthash_read64(p + 0));
+      v2 = ev_contenthash_round(v2, ev_contenthash_read64(p + 8));
+      v3 = ev_contenthash_round(v3, ev_contenthash_read64(p + 16));
+      v4 = ev_contenthash_round(v4, ev_contenthash_read64(p + 24));
+    }
+
+    h = ev_contenthash_rotl(v1, 1) + ev_contenthash_rotl(v2, 7) + ev_contenthash_rotl(v3, 12) + ev_contenthash_rotl(v4, 18);
+    h = ev_contenthash_mergeround(h, v1);
+    h = ev_contenthash_mergeround(h, v2);
+    h = ev_contenthash_mergeround(h, v3);
+    h = ev_contenthash_mergeround(h, v4);
+  } else {
+    h = seed + PRIME64_5;
+  }
+
+  h += size;
+
+  for (; p + 8 <= end; p += 8) {
+    h ^= ev_contenthash_round(0, ev_contenthash_read64(p));
+    h = ev_contenthash_rotl(h, 27) * PRIME64_1 + PRIME64_4;
+  }
+
+  if (p + 4 <= end) {
+    h ^= (uint64_t)ev_contenthash_read32(p) * PRIME64_1;
+    h = ev_contenthash_rotl(h, 23) * PRIME64_2 + PRIME64_3;
+    p += 4;
+  }
+
+  for (; p < end; p++) {
+    h ^= (*p) * PRIME64_5;
+    h = ev_contenthash_rotl(h, 11) * PRIME64_1;
+  }
+
+  h ^= h >> 33;
+  h *= PRIME64_2;
+  h ^= h >> 29;
+  h *= PRIME64_3;
+  h ^= h >> 32;
+  return h;
+}
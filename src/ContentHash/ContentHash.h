@@ -0,0 +1,8 @@
+#pragma once
+
+#include <evol/evol.h>
+
+// 64 bit XXH64 hash of `size` bytes. Fast enough to run over decoded asset
+// payloads on registration; `seed` is used to mix in the metadata that
+// distinguishes equal payloads (dimensions, formats, strides...).
+uint64_t ev_contenthash_compute(const void *data, uint64_t size, uint64_t seed);
@@ -0,0 +1,182 @@
+#include <PixelConversion/PixelConversion.h>
+
+#include <math.h>
+#include <evol/threads/evolpthreads.h>
+
+#if defined(__ARM_NEON)
+  #include <arm_neon.h>
+  #define PIXELCONVERSION_NEON
+#elif (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+  #include <immintrin.h>
+  #define PIXELCONVERSION_X86
+#endif
+
+// NOTE:
+// Kernels only handle the bulk of the image, the remaining pixels always go
+// through the scalar path. x86 kernels are picked at runtime so the module
+// doesn't need to be built with -mavx2.
+
+uint32_t ev_pixelconversion_getdstchannelcount(uint32_t srcChannelCount)
+{
+  return srcChannelCount == 3 ? 4 : srcChannelCount;
+}
+
+static void ev_pixelconversion_rgbtorgba_scalar(const uint8_t *src, uint64_t pixelCount, uint8_t *dst)
+{
+  for (uint64_t i = 0; i < pixelCount; i++) {
+    dst[i * 4 + 0] = src[i * 3 + 0];
+    dst[i * 4 + 1] = src[i * 3 + 1];
+    dst[i * 4 + 2] = src[i * 3 + 2];
+    dst[i * 4 + 3] = 0xFF;
+  }
+}
+
+#if defined(PIXELCONVERSION_X86)
+__attribute__((target("ssse3")))
+static uint64_t ev_pixelconversion_rgbtorgba_ssse3(const uint8_t *src, uint64_t pixelCount, uint8_t *dst)
+{
+  const __m128i shuffle = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+  const __m128i alpha = _mm_set1_epi32((int)0xFF000000);
+
+  uint64_t i = 0;
+  // 16 pixels are 48 bytes in and 64 bytes out
+  for (; i + 16 <= pixelCount; i += 16) {
+    __m128i in0 = _mm_loadu_si128((const __m128i*)(src + i * 3));
+    __m128i in1 = _mm_loadu_si128((const __m128i*)(src + i * 3 + 16));
+    __m128i in2 = _mm_loadu_si128((const __m128i*)(src + i * 3 + 32));
+
+    __m128i out0 = _mm_shuffle_epi8(in0, shuffle);
+    __m128i out1 = _mm_shuffle_epi8(_mm_alignr_epi8(in1, in0, 12), shuffle);
+    __m128i out2 = _mm_shuffle_epi8(_mm_alignr_epi8(in2, in1, 8), shuffle);
+    __m128i out3 = _mm_shuffle_epi8(_mm_srli_si128(in2, 4), shuffle);
+
+    _mm_storeu_si128((__m128i*)(dst + i * 4 + 0), _mm_or_si128(out0, alpha));
+    _mm_storeu_si128((__m128i*)(dst + i * 4 + 16), _mm_or_si128(out1, alpha));
+    _mm_storeu_si128((__m128i*)(dst + i * 4 + 32), _mm_or_si128(out2, alpha));
+    _mm_storeu_si128((__m128i*)(dst + i * 4 + 48), _mm_or_si128(out3, alpha));
+  }
+  return i;
+}
+
+__attribute__((target("avx2")))
+static uint64_t ev_pixelconversion_rgbtorgba_avx2(const uint8_t *src, uint64_t pixelCount, uint8_t *dst)
+{
+  const __m256i shuffle = _mm256_setr_epi8(
+      0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+      0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+  const __m256i alpha = _mm256_set1_epi32((int)0xFF000000);
+
+  uint64_t i = 0;
+  // Each lane expands 4 pixels. The second load reads 4 bytes past the 8
+  // pixels being converted, so stop early enough to stay inside `src`.
+  for (; i + 10 <= pixelCount; i += 8) {
+    __m128i lo = _mm_loadu_si128((const __m128i*)(src + i * 3));
+    __m128i hi = _mm_loadu_si128((const __m128i*)(src + i * 3 + 12));
+
+    __m256i in = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+    __m256i out = _mm256_or_si256(_mm256_shuffle_epi8(in, shuffle), alpha);
+
+    _mm256_storeu_si256((__m256i*)(dst + i * 4), out);
+  }
+  return i;
+}
+#endif
+
+#if defined(PIXELCONVERSION_NEON)
+static uint64_t ev_pixelconversion_rgbtorgba_neon(const uint8_t *src, uint64_t pixelCount, uint8_t *dst)
+{
+  uint64_t i = 0;
+  for (; i + 16 <= pixelCount; i += 16) {
+    uint8x16x3_t in = vld3q_u8(src + i * 3);
+
+    uint8x16x4_t out;
+    out.val[0] = in.val[0];
+    out.val[1] = in.val[1];
+    out.val[2] = in.val[2];
+    out.val[3] = vdupq_n_u8(0xFF);
+
+    vst4q_u8(dst + i * 4, out);
+  }
+  return i;
+}
+#endif
+
+static void ev_pixelconversion_rgbtorgba(const uint8_t *src, uint64_t pixelCount, uint8_t *dst)
+{
+  uint64_t converted = 0;
+
+#if defined(PIXELCONVERSION_X86)
+  if (__builtin_cpu_supports("avx2")) {
+    converted = ev_pixelconversion_rgbtorgba_avx2(src, pixelCount, dst);
+  } else if (__builtin_cpu_supports("ssse3")) {
+    converted = ev_pixelconversion_rgbtorgba_ssse3(src, pixelCount, dst);
+  }
+#elif defined(PIXELCONVERSION_NEON)
+  converted = ev_pixelconversion_rgbtorgba_neon(src, pixelCount, dst);
+#endif
+
+  ev_pixelconversion_rgbtorgba_scalar(src + converted * 3, pixelCount - converted, dst + converted * 4);
+}
+
+void ev_pixelconversion_convert(const void *src, uint32_t srcChannelCount, uint64_t pixelCount, void *dst)
+{
+  if (srcChannelCount == 3) {
+    ev_pixelconversion_rgbtorgba(src, pixelCount, dst);
+  } else {
+    // One, two and four channel images are uploaded as is
+    memcpy(dst, src, pixelCount * srcChannelCount);
+  }
+}
+
+static float SRGBToLinear[256];
+static pthread_once_t SRGBToLinearOnce = PTHREAD_ONCE_INIT;
+
+static void ev_pixelconversion_initsrgbtable()
+{
+  for (uint32_t i = 0; i < 256; i++) {
+    float c = i / 255.0f;
+    SRGBToLinear[i] = c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+  }
+}
+
+static uint8_t ev_pixelconversion_lineartosrgb(float c)
+{
+  c = c <= 0.0031308f ? c * 12.92f : 1.055f * powf(c, 1.0f / 2.4f) - 0.055f;
+  return (uint8_t)(c * 255.0f + 0.5f);
+}
+
+void ev_pixelconversion_downsample(const void *src, uint32_t srcWidth, uint32_t srcHeight, uint32_t channelCount, bool srgb, void *dst)
+{
+  uint32_t dstWidth = srcWidth > 1 ? srcWidth / 2 : 1;
+  uint32_t dstHeight = srcHeight > 1 ? srcHeight / 2 : 1;
+
+  if (srgb) {
+    pthread_once(&SRGBToLinearOnce, ev_pixelconversion_initsrgbtable);
+  }
+
+  // 2x2 box filter, odd edges reuse the last row/column
+  for (uint32_t y = 0; y < dstHeight; y++) {
+    uint32_t y0 = y * 2 < srcHeight ? y * 2 : srcHeight - 1;
+    uint32_t y1 = y * 2 + 1 < srcHeight ? y * 2 + 1 : srcHeight - 1;
+
+    for (uint32_t x = 0; x < dstWidth; x++) {
+      uint32_t x0 = x * 2 < srcWidth ? x * 2 : srcWidth - 1;
+      uint32_t x1 = x * 2 + 1 < srcWidth ? x * 2 + 1 : srcWidth - 1;
+
+      const uint8_t *p00 = (const uint8_t*)src + (y0 * srcWidth + x0) * channelCount;
+      const uint8_t *p01 = (const uint8_t*)src + (y0 * srcWidth + x1) * channelCount;
+      const uint8_t *p10 = (const uint8_t*)src + (y1 * srcWidth + x0) * channelCount;
+      const uint8_t *p11 = (const uint8_t*)src + (y1 * srcWidth + x1) * channelCount;
+
+      uint8_t *out = (uint8_t*)dst + (y * dstWidth + x) * channelCount;
+      for (uint32_t c = 0; c < channelCount; c++) {
+        if (srgb && c < 3) {
+          float sum = SRGBToLinear[p00[c]] + SRGBToLinear[p01[c]] + SRGBToLinear[p10[c]] + SRGBToLinear[p11[c]];
+          out[c] = ev_pixelconversion_lineartosrgb(sum * 0.25f);
+        } else {
+          out[c] = (uint8_t)((p00[c] + p01[c] + p10[c] + p11[c] + 2) >> 2);
+        }
+      }
+    }
+  }
+}
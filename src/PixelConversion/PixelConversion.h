@@ -0,0 +1,17 @@
+#pragma once
+
+#include <evol/evol.h>
+
+// Number of 8 bit channels a decoded image with `srcChannelCount` channels
+// occupies on the gpu. Three channel images get an opaque alpha channel.
+uint32_t ev_pixelconversion_getdstchannelcount(uint32_t srcChannelCount);
+
+// Converts `pixelCount` tightly packed pixels into the layout returned by
+// `ev_pixelconversion_getdstchannelcount`. `dst` is usually mapped staging
+// memory, so it is only ever written to.
+void ev_pixelconversion_convert(const void *src, uint32_t srcChannelCount, uint64_t pixelCount, void *dst);
+
+// Box filters an image into the next mip level, the size of which is half of
+// the source rounded down. sRGB color channels are averaged in linear space,
+// the fourth channel is always treated as linear alpha.
+void ev_pixelconversion_downsample(const void *src, uint32_t srcWidth, uint32_t srcHeight, uint32_t channelCount, bool srgb, void *dst);
@@ -0,0 +1,202 @@
+#include <ThreadPool/ThreadPool.h>
+
+#include <vec.h>
+#include <evol/common/ev_log.h>
+
+typedef struct {
+  // NULL once the job was claimed by `ev_threadpool_waitgroup`
+  ThreadPoolJobFn fn;
+  void *data;
+  bool background;
+  ThreadPoolGroup *group;
+} ThreadPoolJob;
+
+struct {
+  pthread_mutex_t mutex;
+  pthread_cond_t jobAvailable;
+  pthread_cond_t jobsDone;
+
+  vec(pthread_t) threads;
+
+  vec(ThreadPoolJob) jobs;
+  size_t nextJob;
+  // Jobs that were submitted and didn't finish yet, background ones excluded
+  size_t pendingCount;
+
+  bool running;
+} ThreadPoolData;
+
+#define DATA(X) ThreadPoolData.X
+
+// Called with the mutex held once `job` ran
+static void ev_threadpool_finishjob(ThreadPoolJob job)
+{
+  bool done = false;
+  if (job.group && --job.group->pendingCount == 0)
+    done = true;
+  if (!job.background && --DATA(pendingCount) == 0)
+    done = true;
+
+  if (done)
+    pthread_cond_broadcast(&DATA(jobsDone));
+}
+
+static void *ev_threadpool_worker(void *arg)
+{
+  pthread_mutex_lock(&DATA(mutex));
+
+  for (;;)
+  {
+    while (DATA(running) && DATA(nextJob) == vec_len(DATA(jobs)))
+      pthread_cond_wait(&DATA(jobAvailable), &DATA(mutex));
+
+    if (DATA(nextJob) == vec_len(DATA(jobs)))
+      break;
+
+    ThreadPoolJob job = DATA(jobs)[DATA(nextJob)++];
+
+    // Recycle the queue once it's drained
+    if (DATA(nextJob) == vec_len(DATA(jobs)))
+    {
+      vec_clear(DATA(jobs));
+      DATA(nextJob) = 0;
+    }
+
+    // Already run by the thread waiting on its group
+    if (!job.fn)
+      continue;
+
+    pthread_mutex_unlock(&DATA(mutex));
+    job.fn(job.data);
+    pthread_mutex_lock(&DATA(mutex));
+
+    ev_threadpool_finishjob(job);
+  }
+
+  pthread_mutex_unlock(&DATA(mutex));
+
+  return NULL;
+}
+
+void ev_threadpool_init(uint32_t threadCount)
+{
+  pthread_mutex_init(&DATA(mutex), NULL);
+  pthread_cond_init(&DATA(jobAvailable), NULL);
+  pthread_cond_init(&DATA(jobsDone), NULL);
+
+  DATA(jobs) = vec_init(ThreadPoolJob);
+  DATA(nextJob) = 0;
+  DATA(pendingCount) = 0;
+  DATA(running) = true;
+
+  DATA(threads) = vec_init(pthread_t);
+  for (uint32_t i = 0; i < (threadCount ? threadCount : 1); i++)
+  {
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, ev_threadpool_worker, NULL) != 0)
+    {
+      ev_log_error("Couldn't create thread pool worker #%u", i);
+      continue;
+    }
+    vec_push(&DATA(threads), &thread);
+  }
+}
+
+void ev_threadpool_deinit()
+{
+  pthread_mutex_lock(&DATA(mutex));
+  DATA(running) = false;
+  pthread_cond_broadcast(&DATA(jobAvailable));
+  pthread_mutex_unlock(&DATA(mutex));
+
+  for (size_t i = 0; i < vec_len(DATA(threads)); i++)
+    pthread_join(DATA(threads)[i], NULL);
+
+  vec_fini(DATA(threads));
+  vec_fini(DATA(jobs));
+
+  pthread_cond_destroy(&DATA(jobsDone));
+  pthread_cond_destroy(&DATA(jobAvailable));
+  pthread_mutex_destroy(&DATA(mutex));
+}
+
+static void ev_threadpool_push(ThreadPoolJobFn fn, void *data, bool background, ThreadPoolGroup *group)
+{
+  pthread_mutex_lock(&DATA(mutex));
+
+  vec_push(&DATA(jobs), &(ThreadPoolJob) {
+    .fn = fn,
+    .data = data,
+    .background = background,
+    .group = group,
+  });
+  if (!background)
+    DATA(pendingCount)++;
+  if (group)
+    group->pendingCount++;
+
+  pthread_cond_signal(&DATA(jobAvailable));
+  pthread_mutex_unlock(&DATA(mutex));
+}
+
+void ev_threadpool_submit(ThreadPoolJobFn fn, void *data)
+{
+  ev_threadpool_push(fn, data, false, NULL);
+}
+
+void ev_threadpool_submitbackground(ThreadPoolJobFn fn, void *data)
+{
+  ev_threadpool_push(fn, data, true, NULL);
+}
+
+void ev_threadpool_submitgroup(ThreadPoolGroup *group, ThreadPoolJobFn fn, void *data)
+{
+  ev_threadpool_push(fn, data, false, group);
+}
+
+void ev_threadpool_wait()
+{
+  pthread_mutex_lock(&DATA(mutex));
+
+  while (DATA(pendingCount) > 0)
+    pthread_cond_wait(&DATA(jobsDone), &DATA(mutex));
+
+  pthread_mutex_unlock(&DATA(mutex));
+}
+
+void ev_threadpool_waitgroup(ThreadPoolGroup *group)
+{
+  pthread_mutex_lock(&DATA(mutex));
+
+  // Claim the group's queued jobs, the workers skip them once they get there.
+  // The queue can be recycled while a job runs, so the scan starts over each time.
+  for (;;)
+  {
+    size_t i = DATA(nextJob);
+    while (i < vec_len(DATA(jobs)) && (DATA(jobs)[i].group != group || !DATA(jobs)[i].fn))
+      i++;
+
+    if (i == vec_len(DATA(jobs)))
+      break;
+
+    ThreadPoolJob job = DATA(jobs)[i];
+    DATA(jobs)[i].fn = NULL;
+
+    pthread_mutex_unlock(&DATA(mutex));
+    job.fn(job.data);
+    pthread_mutex_lock(&DATA(mutex));
+
+    ev_threadpool_finishjob(job);
+  }
+
+  // The rest is already running on workers
+  while (group->pendingCount > 0)
+    pthread_cond_wait(&DATA(jobsDone), &DATA(mutex));
+
+  pthread_mutex_unlock(&DATA(mutex));
+}
+
+uint32_t ev_threadpool_getthreadcount()
+{
+  return vec_len(DATA(threads));
+}
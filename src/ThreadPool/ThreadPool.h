@@ -0,0 +1,36 @@
+#pragma once
+
+#include <evol/evol.h>
+#include <evol/threads/evolpthreads.h>
+
+typedef void (*ThreadPoolJobFn)(void *data);
+
+// Jobs submitted to a group can be waited on without waiting for the rest of
+// the pool. Zero initialize it before use, it must outlive its jobs.
+typedef struct {
+  size_t pendingCount;
+} ThreadPoolGroup;
+
+void ev_threadpool_init(uint32_t threadCount);
+
+// Waits for every queued job to finish before joining the workers
+void ev_threadpool_deinit();
+
+void ev_threadpool_submit(ThreadPoolJobFn fn, void *data);
+
+// Not waited on by `ev_threadpool_wait`, the job has to publish its own
+// result. Still runs in submission order with the other jobs.
+void ev_threadpool_submitbackground(ThreadPoolJobFn fn, void *data);
+
+// Also counted by `ev_threadpool_wait`
+void ev_threadpool_submitgroup(ThreadPoolGroup *group, ThreadPoolJobFn fn, void *data);
+
+// Blocks until every job submitted so far is done
+void ev_threadpool_wait();
+
+// Blocks until every job of `group` is done. The calling thread runs the
+// group's jobs that no worker picked up yet, so they don't wait behind the
+// rest of the queue.
+void ev_threadpool_waitgroup(ThreadPoolGroup *group);
+
+uint32_t ev_threadpool_getthreadcount();
@@ -1,79 +1,247 @@
 #include <DescriptorManager.h>
 
 #include <vec.h>
+#include <stdlib.h>
 #include <Vulkan_utils.h>
-#include <evol/common/ev_log.h>
+#include <evol/threads/evolpthreads.h>
 
-struct {
+// Core descriptor types, VK_DESCRIPTOR_TYPE_SAMPLER to INPUT_ATTACHMENT
+#define DESCRIPTORMANAGER_TYPE_COUNT 11
+
+// Sets per pool, lowered for layouts that would exceed the descriptor limit
+#define DESCRIPTORPOOL_PERSISTENT_SETS 64
+#define DESCRIPTORPOOL_MAX_DESCRIPTORS 16384
+
+typedef struct {
+  VkDescriptorSetLayout layout;
+  uint32_t descriptorCounts[DESCRIPTORMANAGER_TYPE_COUNT];
+} LayoutDescriptorCounts;
+
+// Pools of a single layout, all created with the same flags
+typedef struct {
+  VkDescriptorSetLayout layout;
+  VkDescriptorPoolCreateFlags flags;
   vec(VkDescriptorPool) pools;
+  // Pools before `current` are full
+  size_t current;
+} DescriptorPoolList;
+
+typedef struct {
+  vec(DescriptorPoolList) lists;
+} ThreadDescriptorPools;
+
+struct {
+  // Guards everything below, only taken when a thread creates pools
+  pthread_mutex_t mutex;
+  vec(LayoutDescriptorCounts) layouts;
+  vec(ThreadDescriptorPools*) threads;
 } DescriptorManagerData;
 
 #define DATA(X) DescriptorManagerData.X
 
-void createPool(int count, VkDescriptorPoolCreateFlags flags);
+static _Thread_local ThreadDescriptorPools *ThreadPools;
+
+static const float GenericDescriptorRatios[DESCRIPTORMANAGER_TYPE_COUNT] = {
+  [VK_DESCRIPTOR_TYPE_SAMPLER]                = 0.5f,
+  [VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER] = 4.f,
+  [VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE]          = 4.f,
+  [VK_DESCRIPTOR_TYPE_STORAGE_IMAGE]          = 1.f,
+  [VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER]   = 1.f,
+  [VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER]   = 1.f,
+  [VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER]         = 2.f,
+  [VK_DESCRIPTOR_TYPE_STORAGE_BUFFER]         = 2.f,
+  [VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC] = 1.f,
+  [VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC] = 1.f,
+  [VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT]       = 0.5f,
+};
+
+static void ev_descriptormanager_destroypoollist(DescriptorPoolList *list)
+{
+  vec_fini(list->pools);
+}
+
+static void ev_descriptormanager_destroythread(ThreadDescriptorPools **pools)
+{
+  vec_fini((*pools)->lists);
+  free(*pools);
+}
+
+// The calling thread's pools, created on its first allocation
+static ThreadDescriptorPools *ev_descriptormanager_getthreadpools()
+{
+  if (ThreadPools) {
+    return ThreadPools;
+  }
+
+  ThreadPools = malloc(sizeof(ThreadDescriptorPools));
+  ThreadPools->lists = vec_init(DescriptorPoolList, NULL, ev_descriptormanager_destroypoollist);
+
+  pthread_mutex_lock(&DATA(mutex));
+  vec_push(&DATA(threads), &ThreadPools);
+  pthread_mutex_unlock(&DATA(mutex));
+
+  return ThreadPools;
+}
+
+// The calling thread's pools for `layout`, created on first use. Only this
+// thread touches them, so no lock is needed.
+static DescriptorPoolList *ev_descriptormanager_getpoollist(VkDescriptorSetLayout layout, VkDescriptorPoolCreateFlags flags)
+{
+  ThreadDescriptorPools *pools = ev_descriptormanager_getthreadpools();
+
+  for (size_t i = 0; i < vec_len(pools->lists); i++) {
+    if (pools->lists[i].layout == layout && pools->lists[i].flags == flags)
+      return &pools->lists[i];
+  }
+
+  DescriptorPoolList list = {
+    .layout = layout,
+    .flags = flags,
+    .pools = vec_init(VkDescriptorPool, NULL, ev_vulkan_destroydescriptorpool),
+    .current = 0,
+  };
+  size_t index = vec_push(&pools->lists, &list);
+  return &pools->lists[index];
+}
 
 void ev_descriptormanager_init()
 {
-  DATA(pools) = vec_init(VkDescriptorPool, NULL, ev_vulkan_destroydescriptorpool);
-  createPool(1000, 0);
+  pthread_mutex_init(&DATA(mutex), NULL);
+  DATA(layouts) = vec_init(LayoutDescriptorCounts);
+  DATA(threads) = vec_init(ThreadDescriptorPools*, NULL, ev_descriptormanager_destroythread);
 }
 
 void ev_descriptormanager_dinit()
 {
-  vec_fini(DATA(pools));
+  vec_fini(DATA(threads));
+  vec_fini(DATA(layouts));
+  pthread_mutex_destroy(&DATA(mutex));
+
+  // Only the thread that tears the renderer down can clear its own pointer
+  ThreadPools = NULL;
 }
 
-void createPool(int count, VkDescriptorPoolCreateFlags flags)
+void ev_descriptormanager_registerlayout(VkDescriptorSetLayout layout, uint32_t bindingCount, const VkDescriptorSetLayoutBinding *bindings)
 {
-  VkDescriptorPoolSize sizes[] =
-  {
-    { VK_DESCRIPTOR_TYPE_SAMPLER, 0.5 * count },
-    { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4.f * count},
-    { VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 4.f * count},
-    { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1.f * count},
-    { VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER, 1.f * count},
-    { VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER, 1.f * count},
-    { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2.f * count},
-    { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2.f * count},
-    { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1.f * count},
-    { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1.f * count},
-    { VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 0.5f * count}
+  LayoutDescriptorCounts counts = {
+    .layout = layout,
   };
+  for (uint32_t i = 0; i < bindingCount; i++) {
+    if (bindings[i].descriptorType < DESCRIPTORMANAGER_TYPE_COUNT)
+      counts.descriptorCounts[bindings[i].descriptorType] += bindings[i].descriptorCount;
+  }
+
+  pthread_mutex_lock(&DATA(mutex));
+
+  // Handles of destroyed layouts can be reused
+  size_t i = 0;
+  while (i < vec_len(DATA(layouts)) && DATA(layouts)[i].layout != layout)
+    i++;
+
+  if (i < vec_len(DATA(layouts))) {
+    DATA(layouts)[i] = counts;
+  }
+  else {
+    vec_push(&DATA(layouts), &counts);
+  }
+
+  pthread_mutex_unlock(&DATA(mutex));
+}
+
+// Creates a pool that fits `maxSets` sets of `layout`
+static VkDescriptorPool ev_descriptormanager_createpool(VkDescriptorSetLayout layout, uint32_t maxSets, VkDescriptorPoolCreateFlags flags)
+{
+  const LayoutDescriptorCounts *counts = NULL;
+
+  pthread_mutex_lock(&DATA(mutex));
+  for (size_t i = 0; i < vec_len(DATA(layouts)) && !counts; i++) {
+    if (DATA(layouts)[i].layout == layout)
+      counts = &DATA(layouts)[i];
+  }
+
+  VkDescriptorPoolSize sizes[DESCRIPTORMANAGER_TYPE_COUNT];
+  uint32_t sizeCount = 0;
+
+  if (counts) {
+    uint32_t setDescriptorCount = 0;
+    for (uint32_t type = 0; type < DESCRIPTORMANAGER_TYPE_COUNT; type++)
+      setDescriptorCount += counts->descriptorCounts[type];
+
+    if (setDescriptorCount * maxSets > DESCRIPTORPOOL_MAX_DESCRIPTORS)
+      maxSets = MAX(1, DESCRIPTORPOOL_MAX_DESCRIPTORS / setDescriptorCount);
+
+    for (uint32_t type = 0; type < DESCRIPTORMANAGER_TYPE_COUNT; type++) {
+      if (counts->descriptorCounts[type] > 0) {
+        sizes[sizeCount++] = (VkDescriptorPoolSize) { type, counts->descriptorCounts[type] * maxSets };
+      }
+    }
+  }
+  else {
+    for (uint32_t type = 0; type < DESCRIPTORMANAGER_TYPE_COUNT; type++) {
+      sizes[sizeCount++] = (VkDescriptorPoolSize) { type, MAX(1, GenericDescriptorRatios[type] * maxSets) };
+    }
+  }
+
+  pthread_mutex_unlock(&DATA(mutex));
 
   VkDescriptorPoolCreateInfo info =
   {
     .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
     .pNext = VK_NULL_HANDLE,
     .flags = flags,
-    .maxSets = count,
-    .poolSizeCount = ARRAYSIZE(sizes),
+    .maxSets = maxSets,
+    .poolSizeCount = sizeCount,
     .pPoolSizes = sizes,
   };
 
   VkDescriptorPool pool;
-	ev_vulkan_createdescriptorpool(&info, &pool);
-
-  vec_push(&DATA(pools), &pool);
+  ev_vulkan_createdescriptorpool(&info, &pool);
+  return pool;
 }
 
-VkResult ev_descriptormanager_allocate(VkDescriptorSetLayout layout, VkDescriptorSet* set)
+// Linear allocation, moves on to the next pool once the current one is full.
+// Every pool in the list was sized for the same layout, so running out of
+// memory means the pool really is full.
+static VkResult ev_descriptormanager_allocatefromlist(DescriptorPoolList *list, VkDescriptorSet *set)
 {
-  VkDescriptorSetAllocateInfo info;
-  info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-  info.pNext = NULL;
-  info.descriptorPool = *((VkDescriptorPool*)vec_last(DATA(pools)));
-  info.descriptorSetCount = 1;
-  info.pSetLayouts = &layout;
+  for (;;)
+  {
+    bool freshPool = list->current == vec_len(list->pools);
+    if (freshPool) {
+      VkDescriptorPool pool = ev_descriptormanager_createpool(list->layout, DESCRIPTORPOOL_PERSISTENT_SETS, list->flags);
+      vec_push(&list->pools, &pool);
+    }
 
-  VkResult result = ev_vulkan_allocatedescriptor(&info, set);
+    VkDescriptorSetAllocateInfo info = {
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+      .pNext = NULL,
+      .descriptorPool = list->pools[list->current],
+      .descriptorSetCount = 1,
+      .pSetLayouts = &list->layout,
+    };
 
-  switch (result)
-  {
-    case VK_ERROR_OUT_OF_POOL_MEMORY_KHR:
-      createPool(1000, 0);
-      VK_ASSERT(ev_descriptormanager_allocate(layout, set));
-      break;
-    default:
-      break;
+    VkResult result = ev_vulkan_allocatedescriptor(&info, set);
+
+    // A pool that was just created for this layout and still can't fit it
+    // won't be helped by another one
+    if (freshPool || (result != VK_ERROR_OUT_OF_POOL_MEMORY && result != VK_ERROR_FRAGMENTED_POOL)) {
+      return result;
+    }
+
+    list->current++;
   }
 }
+
+VkResult ev_descriptormanager_allocate(VkDescriptorSetLayout layout, VkDescriptorSet* set)
+{
+  VkResult result = ev_descriptormanager_allocatefromlist(ev_descriptormanager_getpoollist(layout, 0), set);
+  VK_ASSERT(result);
+  return result;
+}
+
+VkResult ev_descriptormanager_allocateupdateafterbind(VkDescriptorSetLayout layout, VkDescriptorSet* set)
+{
+  VkResult result = ev_descriptormanager_allocatefromlist(ev_descriptormanager_getpoollist(layout, VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT), set);
+  VK_ASSERT(result);
+  return result;
+}
@@ -2,8 +2,23 @@
 
 #include <Vulkan.h>
 
+// NOTE:
+// Every thread allocates from its own pools, so allocations never take a
+// lock unless a new pool has to be created. Each layout gets its own pools
+// sized after its registered descriptor counts, so a full pool is never
+// abandoned because another layout's descriptor types didn't fit in it.
+
 void ev_descriptormanager_init();
 
 void ev_descriptormanager_dinit();
 
+// Records the descriptor counts of a layout. Layouts that were never
+// registered get pools with generic ratios.
+void ev_descriptormanager_registerlayout(VkDescriptorSetLayout layout, uint32_t bindingCount, const VkDescriptorSetLayoutBinding *bindings);
+
+// Allocates a set that lives until deinit
 VkResult ev_descriptormanager_allocate(VkDescriptorSetLayout layout, VkDescriptorSet* set);
+
+// Same as `ev_descriptormanager_allocate`, for layouts created with
+// VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT
+VkResult ev_descriptormanager_allocateupdateafterbind(VkDescriptorSetLayout layout, VkDescriptorSet* set);
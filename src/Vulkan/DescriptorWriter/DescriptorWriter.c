@@ -0,0 +1,116 @@
+#include <DescriptorWriter/DescriptorWriter.h>
+
+void ev_descriptorwriter_init(DescriptorWriter *writer)
+{
+  writer->writes = vec_init(PendingDescriptorWrite);
+  writer->bufferInfos = vec_init(VkDescriptorBufferInfo);
+  writer->imageInfos = vec_init(VkDescriptorImageInfo);
+}
+
+void ev_descriptorwriter_deinit(DescriptorWriter *writer)
+{
+  vec_fini(writer->writes);
+  vec_fini(writer->bufferInfos);
+  vec_fini(writer->imageInfos);
+}
+
+// Grows the last write instead of adding a new one when `arrayElement`
+// directly follows it and its infos are still at the end of the list
+static bool ev_descriptorwriter_extend(DescriptorWriter *writer, VkDescriptorSet dstSet, Binding *binding, uint32_t arrayElement, uint32_t infoIndex)
+{
+  if (vec_len(writer->writes) == 0) {
+    return false;
+  }
+
+  PendingDescriptorWrite *last = &writer->writes[vec_len(writer->writes) - 1];
+  if (last->write.dstSet != dstSet
+   || last->write.dstBinding != binding->binding
+   || last->write.descriptorType != binding->type
+   || last->write.dstArrayElement + last->write.descriptorCount != arrayElement
+   || last->firstInfo + last->write.descriptorCount != infoIndex) {
+    return false;
+  }
+
+  last->write.descriptorCount++;
+  return true;
+}
+
+void ev_descriptorwriter_write(DescriptorWriter *writer, uint32_t setIndex, VkImageLayout layout, DescriptorSet set, Binding *binding, uint32_t arrayElement, void *data)
+{
+  uint32_t infoIndex;
+
+  switch(binding->type)
+  {
+    case VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER:
+    case VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER:
+    case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
+    case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
+      infoIndex = vec_push(&writer->bufferInfos, &(VkDescriptorBufferInfo) {
+        .buffer = ((EvBuffer*)data)->buffer,
+        .offset = 0,
+        .range = VK_WHOLE_SIZE,
+      });
+      break;
+    case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
+    case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
+    case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC:
+    case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC:
+    case VK_DESCRIPTOR_TYPE_SAMPLER:
+    case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
+      infoIndex = vec_push(&writer->imageInfos, &(VkDescriptorImageInfo) {
+        .imageLayout = layout,
+        .imageView = ((EvTexture*)data)->imageView,
+        .sampler = ((EvTexture*)data)->sampler,
+      });
+      break;
+    case VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT:
+    default:
+      return;
+  }
+
+  if (ev_descriptorwriter_extend(writer, set.set[setIndex], binding, arrayElement, infoIndex)) {
+    return;
+  }
+
+  vec_push(&writer->writes, &(PendingDescriptorWrite) {
+    .write = {
+      .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+      .descriptorCount = 1,
+      .descriptorType = binding->type,
+      .dstSet = set.set[setIndex],
+      .dstBinding = binding->binding,
+      .dstArrayElement = arrayElement,
+    },
+    .firstInfo = infoIndex,
+  });
+}
+
+void ev_descriptorwriter_flush(DescriptorWriter *writer)
+{
+  size_t writeCount = vec_len(writer->writes);
+  if (writeCount == 0) {
+    return;
+  }
+
+  // The info lists may have moved while growing, pointers are only taken now
+  vec(VkWriteDescriptorSet) writes = vec_init(VkWriteDescriptorSet);
+  vec_setlen(&writes, writeCount);
+  for (size_t i = 0; i < writeCount; i++) {
+    writes[i] = writer->writes[i].write;
+    if (writes[i].descriptorType == VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER
+     || writes[i].descriptorType == VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER
+     || writes[i].descriptorType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER
+     || writes[i].descriptorType == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER) {
+      writes[i].pBufferInfo = &writer->bufferInfos[writer->writes[i].firstInfo];
+    } else {
+      writes[i].pImageInfo = &writer->imageInfos[writer->writes[i].firstInfo];
+    }
+  }
+
+  vkUpdateDescriptorSets(ev_vulkan_getlogicaldevice(), writeCount, writes, 0, NULL);
+  vec_fini(writes);
+
+  vec_clear(writer->writes);
+  vec_clear(writer->bufferInfos);
+  vec_clear(writer->imageInfos);
+}
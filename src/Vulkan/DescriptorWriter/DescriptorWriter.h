@@ -0,0 +1,29 @@
+#pragma once
+
+#include <Vulkan.h>
+
+// Collects descriptor writes and submits them in a single
+// vkUpdateDescriptorSets call. Writes to consecutive array elements of the
+// same binding are merged into one VkWriteDescriptorSet.
+typedef struct {
+  VkWriteDescriptorSet write;
+  // Index of the first info of the write in the writer's info list
+  uint32_t firstInfo;
+} PendingDescriptorWrite;
+
+typedef struct {
+  vec(PendingDescriptorWrite) writes;
+  vec(VkDescriptorBufferInfo) bufferInfos;
+  vec(VkDescriptorImageInfo) imageInfos;
+} DescriptorWriter;
+
+void ev_descriptorwriter_init(DescriptorWriter *writer);
+
+void ev_descriptorwriter_deinit(DescriptorWriter *writer);
+
+// Same arguments as `ev_vulkan_writeintobinding`, but nothing is written
+// until the next flush. `data` is copied, it doesn't need to outlive the call.
+void ev_descriptorwriter_write(DescriptorWriter *writer, uint32_t setIndex, VkImageLayout layout, DescriptorSet set, Binding *binding, uint32_t arrayElement, void *data);
+
+// Updates every pending write and empties the writer
+void ev_descriptorwriter_flush(DescriptorWriter *writer);
@@ -0,0 +1,89 @@
+#include <GeometryBuffer/GeometryBuffer.h>
+
+#include <vec.h>
+#include <Vulkan_utils.h>
+#include <evol/common/ev_log.h>
+
+// NOTE:
+// Every page owns a VMA virtual block which handles the actual sub-allocation
+// (TLSF). The page size is only fixed in bytes when the geometry buffer is
+// created, the element size gets locked by the first allocation since every
+// page needs to hold a whole number of elements.
+
+static void ev_geometrybuffer_destroypage(GeometryPage *page)
+{
+  vmaClearVirtualBlock(page->block);
+  vmaDestroyVirtualBlock(page->block);
+  ev_vulkan_destroybuffer(&page->buffer);
+}
+
+void ev_geometrybuffer_init(GeometryBuffer *geometryBuffer, unsigned long long pageSize)
+{
+  geometryBuffer->elementSize = 0;
+  geometryBuffer->pageSize = pageSize;
+  geometryBuffer->pages = vec_init(GeometryPage, NULL, ev_geometrybuffer_destroypage);
+}
+
+void ev_geometrybuffer_deinit(GeometryBuffer *geometryBuffer)
+{
+  vec_fini(geometryBuffer->pages);
+}
+
+static bool ev_geometrybuffer_allocateinpage(GeometryPage *page, uint32_t elementCount, GeometryRange *range)
+{
+  VmaVirtualAllocationCreateInfo allocationCreateInfo = {
+    .size = elementCount,
+  };
+
+  VkDeviceSize offset;
+  if (vmaVirtualAllocate(page->block, &allocationCreateInfo, &range->allocation, &offset) != VK_SUCCESS)
+    return false;
+
+  range->elementOffset = (uint32_t)offset;
+  return true;
+}
+
+bool ev_geometrybuffer_allocate(GeometryBuffer *geometryBuffer, uint32_t elementSize, uint32_t elementCount, GeometryRange *range)
+{
+  if (geometryBuffer->elementSize == 0)
+    geometryBuffer->elementSize = elementSize;
+  DEBUG_ASSERT(geometryBuffer->elementSize == elementSize);
+
+  for (size_t i = 0; i < vec_len(geometryBuffer->pages); i++)
+  {
+    if (ev_geometrybuffer_allocateinpage(&geometryBuffer->pages[i], elementCount, range))
+    {
+      range->pageIndex = i;
+      return false;
+    }
+  }
+
+  // Meshes bigger than a page get a page of their own
+  GeometryPage newPage;
+  newPage.elementCount = MAX(geometryBuffer->pageSize / elementSize, elementCount);
+  ev_vulkan_allocateresourcebuffer((unsigned long long)newPage.elementCount * elementSize, &newPage.buffer);
+  newPage.address = ev_vulkan_hasbufferdeviceaddress() ? ev_vulkan_getbufferaddress(&newPage.buffer) : 0;
+
+  VmaVirtualBlockCreateInfo blockCreateInfo = {
+    .size = newPage.elementCount,
+  };
+  VK_ASSERT(vmaCreateVirtualBlock(&blockCreateInfo, &newPage.block));
+
+  range->pageIndex = vec_push(&geometryBuffer->pages, &newPage);
+  if (!ev_geometrybuffer_allocateinpage(&geometryBuffer->pages[range->pageIndex], elementCount, range))
+    ev_log_error("Couldn't allocate %u elements in a new geometry page", elementCount);
+
+  ev_log_debug("New geometry page #%u: %u elements of %u bytes", range->pageIndex, newPage.elementCount, elementSize);
+
+  return true;
+}
+
+void ev_geometrybuffer_free(GeometryBuffer *geometryBuffer, GeometryRange *range)
+{
+  vmaVirtualFree(geometryBuffer->pages[range->pageIndex].block, range->allocation);
+}
+
+EvBuffer *ev_geometrybuffer_getpage(GeometryBuffer *geometryBuffer, uint32_t pageIndex)
+{
+  return &geometryBuffer->pages[pageIndex].buffer;
+}
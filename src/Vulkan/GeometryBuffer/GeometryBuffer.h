@@ -0,0 +1,39 @@
+#pragma once
+
+#include <Vulkan.h>
+
+// A geometry buffer is a list of large device buffers ("pages") that meshes
+// are sub-allocated from. Sizes and offsets are expressed in elements
+// (vertices or indices) so that shaders can index a page directly.
+typedef struct {
+  EvBuffer buffer;
+  VmaVirtualBlock block;
+  uint32_t elementCount;
+  // Zero unless buffer device address is enabled
+  VkDeviceAddress address;
+} GeometryPage;
+
+typedef struct {
+  uint32_t elementSize;
+  unsigned long long pageSize;
+  vec(GeometryPage) pages;
+} GeometryBuffer;
+
+typedef struct {
+  uint32_t pageIndex;
+  uint32_t elementOffset;
+  VmaVirtualAllocation allocation;
+} GeometryRange;
+
+void ev_geometrybuffer_init(GeometryBuffer *geometryBuffer, unsigned long long pageSize);
+
+void ev_geometrybuffer_deinit(GeometryBuffer *geometryBuffer);
+
+// Reserves `elementCount` elements of `elementSize` bytes each. A new page is
+// created when none of the existing ones has room, in which case the function
+// returns true and the page needs to be bound before it's used.
+bool ev_geometrybuffer_allocate(GeometryBuffer *geometryBuffer, uint32_t elementSize, uint32_t elementCount, GeometryRange *range);
+
+void ev_geometrybuffer_free(GeometryBuffer *geometryBuffer, GeometryRange *range);
+
+EvBuffer *ev_geometrybuffer_getpage(GeometryBuffer *geometryBuffer, uint32_t pageIndex);
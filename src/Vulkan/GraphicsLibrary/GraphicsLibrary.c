@@ -0,0 +1,157 @@
+#include <GraphicsLibrary/GraphicsLibrary.h>
+
+#include <Vulkan_utils.h>
+#include <ContentHash/ContentHash.h>
+#include <PipelineCache/PipelineCache.h>
+#include <evol/threads/evolpthreads.h>
+
+typedef struct {
+  uint64_t hash;
+  GraphicsLibraryKey key;
+  VkPipeline library;
+} CachedGraphicsLibrary;
+
+struct {
+  // Pipelines are built on the worker threads
+  pthread_mutex_t mutex;
+  vec(CachedGraphicsLibrary) libraries;
+} GraphicsLibraryData;
+
+#define DATA(X) GraphicsLibraryData.X
+
+static const VkGraphicsPipelineLibraryFlagsEXT GraphicsLibraryPartFlags[GRAPHICS_LIBRARY_COUNT] = {
+  [GRAPHICS_LIBRARY_VERTEX_INPUT]      = VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT,
+  [GRAPHICS_LIBRARY_PRE_RASTERIZATION] = VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT,
+  [GRAPHICS_LIBRARY_FRAGMENT_SHADER]   = VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT,
+  [GRAPHICS_LIBRARY_FRAGMENT_OUTPUT]   = VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT,
+};
+
+static void ev_graphicslibrary_destroyentry(CachedGraphicsLibrary *entry)
+{
+  ev_vulkan_destroypipeline(entry->library);
+}
+
+// Returns the cached library, or VK_NULL_HANDLE. Must hold the mutex.
+static VkPipeline ev_graphicslibrary_find(uint64_t hash, const GraphicsLibraryKey *key)
+{
+  for (size_t i = 0; i < vec_len(DATA(libraries)); i++) {
+    CachedGraphicsLibrary *entry = &DATA(libraries)[i];
+    if (entry->hash == hash && !memcmp(&entry->key, key, sizeof(GraphicsLibraryKey))) {
+      return entry->library;
+    }
+  }
+  return VK_NULL_HANDLE;
+}
+
+void ev_graphicslibrary_init()
+{
+  pthread_mutex_init(&DATA(mutex), NULL);
+  DATA(libraries) = vec_init(CachedGraphicsLibrary, NULL, ev_graphicslibrary_destroyentry);
+}
+
+void ev_graphicslibrary_deinit()
+{
+  vec_fini(DATA(libraries));
+  pthread_mutex_destroy(&DATA(mutex));
+}
+
+VkPipeline ev_graphicslibrary_get(const GraphicsLibraryKey *key, const VkGraphicsPipelineCreateInfo *createInfo)
+{
+  // Copied into a zeroed key so that padding doesn't affect the hash
+  GraphicsLibraryKey canonical;
+  memset(&canonical, 0, sizeof(GraphicsLibraryKey));
+  canonical.part = key->part;
+  canonical.renderPass = key->renderPass;
+  canonical.subpass = key->subpass;
+  canonical.layout = key->layout;
+  memcpy(canonical.modules, key->modules, sizeof(canonical.modules));
+  canonical.specializationHash = key->specializationHash;
+  uint64_t hash = ev_contenthash_compute(&canonical, sizeof(GraphicsLibraryKey), 0);
+
+  pthread_mutex_lock(&DATA(mutex));
+  VkPipeline library = ev_graphicslibrary_find(hash, &canonical);
+  pthread_mutex_unlock(&DATA(mutex));
+
+  if (library) {
+    return library;
+  }
+
+  // Compiled without holding the lock so that different parts build in
+  // parallel. If another thread wins the race, its library is kept.
+  VkGraphicsPipelineLibraryCreateInfoEXT libraryCreateInfo = {
+    .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_LIBRARY_CREATE_INFO_EXT,
+    .pNext = createInfo->pNext,
+    .flags = GraphicsLibraryPartFlags[canonical.part],
+  };
+
+  VkGraphicsPipelineCreateInfo libraryPipelineCreateInfo = *createInfo;
+  libraryPipelineCreateInfo.pNext = &libraryCreateInfo;
+  libraryPipelineCreateInfo.flags |= VK_PIPELINE_CREATE_LIBRARY_BIT_KHR |
+                                     VK_PIPELINE_CREATE_RETAIN_LINK_TIME_OPTIMIZATION_INFO_BIT_EXT;
+
+  VK_ASSERT(
+    vkCreateGraphicsPipelines(
+      ev_vulkan_getlogicaldevice(), ev_pipelinecache_get(),
+      1,
+      &libraryPipelineCreateInfo, NULL,
+      &library)
+    );
+  ev_pipelinecache_markdirty();
+
+  pthread_mutex_lock(&DATA(mutex));
+
+  VkPipeline existing = ev_graphicslibrary_find(hash, &canonical);
+  if (existing) {
+    ev_vulkan_destroypipeline(library);
+    library = existing;
+  }
+  else {
+    vec_push(&DATA(libraries), &(CachedGraphicsLibrary) {
+      .hash = hash,
+      .key = canonical,
+      .library = library,
+    });
+  }
+
+  pthread_mutex_unlock(&DATA(mutex));
+  return library;
+}
+
+VkPipeline ev_graphicslibrary_link(const VkPipeline libraries[GRAPHICS_LIBRARY_COUNT], VkPipelineLayout layout, bool optimize)
+{
+  VkPipelineLibraryCreateInfoKHR libraryCreateInfo = {
+    .sType = VK_STRUCTURE_TYPE_PIPELINE_LIBRARY_CREATE_INFO_KHR,
+    .libraryCount = GRAPHICS_LIBRARY_COUNT,
+    .pLibraries = libraries,
+  };
+
+  VkGraphicsPipelineCreateInfo createInfo = {
+    .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+    .pNext = &libraryCreateInfo,
+    .flags = optimize ? VK_PIPELINE_CREATE_LINK_TIME_OPTIMIZATION_BIT_EXT : 0,
+    .layout = layout,
+  };
+
+  VkPipeline pipeline;
+  VK_ASSERT(
+    vkCreateGraphicsPipelines(
+      ev_vulkan_getlogicaldevice(), ev_pipelinecache_get(),
+      1,
+      &createInfo, NULL,
+      &pipeline)
+    );
+  ev_pipelinecache_markdirty();
+
+  return pipeline;
+}
+
+uint64_t ev_graphicslibrary_hashspecialization(const VkSpecializationInfo *specializationInfo)
+{
+  if (!specializationInfo || specializationInfo->mapEntryCount == 0) {
+    return 0;
+  }
+
+  uint64_t hash = ev_contenthash_compute(specializationInfo->pMapEntries,
+      specializationInfo->mapEntryCount * sizeof(VkSpecializationMapEntry), 0);
+  return ev_contenthash_compute(specializationInfo->pData, specializationInfo->dataSize, hash);
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <Vulkan.h>
+
+// NOTE:
+// Only used when `ev_vulkan_hasgraphicspipelinelibrary` is true. A graphics
+// pipeline is split into four parts that are compiled once and shared
+// between every pipeline with the same inputs, linking them is cheap enough
+// to happen while a scene is loading.
+
+typedef enum {
+  GRAPHICS_LIBRARY_VERTEX_INPUT,
+  GRAPHICS_LIBRARY_PRE_RASTERIZATION,
+  GRAPHICS_LIBRARY_FRAGMENT_SHADER,
+  GRAPHICS_LIBRARY_FRAGMENT_OUTPUT,
+
+  GRAPHICS_LIBRARY_COUNT
+} GraphicsLibraryPart;
+
+#define GRAPHICS_LIBRARY_MAX_STAGES 4
+
+// Everything a part depends on. Fields that don't affect the part are left
+// zeroed.
+typedef struct {
+  GraphicsLibraryPart part;
+  VkRenderPass renderPass;
+  uint32_t subpass;
+  VkPipelineLayout layout;
+  VkShaderModule modules[GRAPHICS_LIBRARY_MAX_STAGES];
+  uint64_t specializationHash;
+} GraphicsLibraryKey;
+
+void ev_graphicslibrary_init();
+
+// Destroys every library that was handed out
+void ev_graphicslibrary_deinit();
+
+// Returns the library matching `key`, creating it from `createInfo` on the
+// first request. `createInfo` only has to describe the state of `key.part`,
+// the library flags are added here. Safe to call from multiple threads.
+VkPipeline ev_graphicslibrary_get(const GraphicsLibraryKey *key, const VkGraphicsPipelineCreateInfo *createInfo);
+
+// Links one library of each part into a pipeline. Without `optimize` the
+// link is fast but the result may run slower than a monolithic pipeline,
+// with it the driver compiles the whole pipeline again.
+VkPipeline ev_graphicslibrary_link(const VkPipeline libraries[GRAPHICS_LIBRARY_COUNT], VkPipelineLayout layout, bool optimize);
+
+// Hash of the specialization constants of a part, zero when there are none
+uint64_t ev_graphicslibrary_hashspecialization(const VkSpecializationInfo *specializationInfo);
@@ -0,0 +1,141 @@
+#include <KTX2/KTX2.h>
+
+#include <Vulkan_utils.h>
+#include <evol/common/ev_log.h>
+
+static const uint8_t KTX2Identifier[12] = {
+  0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'
+};
+
+typedef struct {
+  uint8_t identifier[12];
+  uint32_t vkFormat;
+  uint32_t typeSize;
+  uint32_t pixelWidth;
+  uint32_t pixelHeight;
+  uint32_t pixelDepth;
+  uint32_t layerCount;
+  uint32_t faceCount;
+  uint32_t levelCount;
+  uint32_t supercompressionScheme;
+
+  uint32_t dfdByteOffset;
+  uint32_t dfdByteLength;
+  uint32_t kvdByteOffset;
+  uint32_t kvdByteLength;
+  uint64_t sgdByteOffset;
+  uint64_t sgdByteLength;
+} KTX2Header;
+
+typedef struct {
+  uint64_t byteOffset;
+  uint64_t byteLength;
+  uint64_t uncompressedByteLength;
+} KTX2LevelIndex;
+
+// Block footprint of the supported formats, uncompressed ones are 1x1 blocks
+static bool ev_ktx2_getformatblock(VkFormat format, uint32_t *blockWidth, uint32_t *blockHeight, uint32_t *blockBytes)
+{
+  switch (format) {
+    case VK_FORMAT_R8G8B8A8_UNORM:
+    case VK_FORMAT_R8G8B8A8_SRGB:
+      *blockWidth = 1; *blockHeight = 1; *blockBytes = 4;
+      return true;
+    case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+    case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+      *blockWidth = 4; *blockHeight = 4; *blockBytes = 8;
+      return true;
+    case VK_FORMAT_BC3_UNORM_BLOCK:
+    case VK_FORMAT_BC3_SRGB_BLOCK:
+    case VK_FORMAT_BC5_UNORM_BLOCK:
+    case VK_FORMAT_BC5_SNORM_BLOCK:
+    case VK_FORMAT_BC7_UNORM_BLOCK:
+    case VK_FORMAT_BC7_SRGB_BLOCK:
+    case VK_FORMAT_ASTC_4x4_UNORM_BLOCK:
+    case VK_FORMAT_ASTC_4x4_SRGB_BLOCK:
+      *blockWidth = 4; *blockHeight = 4; *blockBytes = 16;
+      return true;
+    case VK_FORMAT_ASTC_6x6_UNORM_BLOCK:
+    case VK_FORMAT_ASTC_6x6_SRGB_BLOCK:
+      *blockWidth = 6; *blockHeight = 6; *blockBytes = 16;
+      return true;
+    case VK_FORMAT_ASTC_8x8_UNORM_BLOCK:
+    case VK_FORMAT_ASTC_8x8_SRGB_BLOCK:
+      *blockWidth = 8; *blockHeight = 8; *blockBytes = 16;
+      return true;
+    default:
+      return false;
+  }
+}
+
+bool ev_ktx2_parse(const void *data, unsigned long long size, KTX2Texture *texture)
+{
+  const uint8_t *bytes = data;
+
+  if (size < sizeof(KTX2Header)) {
+    ev_log_error("[KTX2] File is too small to hold a header");
+    return false;
+  }
+
+  KTX2Header header;
+  memcpy(&header, bytes, sizeof(KTX2Header));
+
+  if (memcmp(header.identifier, KTX2Identifier, sizeof(KTX2Identifier))) {
+    ev_log_error("[KTX2] Invalid identifier");
+    return false;
+  }
+
+  if (header.supercompressionScheme != 0) {
+    ev_log_error("[KTX2] Supercompression scheme %u is not supported", header.supercompressionScheme);
+    return false;
+  }
+
+  if (header.pixelDepth > 1 || header.layerCount > 1 || header.faceCount != 1 || header.pixelWidth == 0 || header.pixelHeight == 0) {
+    ev_log_error("[KTX2] Only single layer 2D textures are supported");
+    return false;
+  }
+
+  uint32_t blockWidth, blockHeight, blockBytes;
+  if (!ev_ktx2_getformatblock(header.vkFormat, &blockWidth, &blockHeight, &blockBytes)) {
+    ev_log_error("[KTX2] VkFormat %u is not supported", header.vkFormat);
+    return false;
+  }
+
+  // The level index always has at least one entry, even when the mips are to be generated
+  uint32_t indexCount = MAX(header.levelCount, 1);
+  if (indexCount > ev_vulkan_getmipcount(header.pixelWidth, header.pixelHeight) || size < sizeof(KTX2Header) + sizeof(KTX2LevelIndex) * indexCount) {
+    ev_log_error("[KTX2] Invalid level index");
+    return false;
+  }
+
+  texture->format = header.vkFormat;
+  texture->width = header.pixelWidth;
+  texture->height = header.pixelHeight;
+  texture->levelCount = header.levelCount;
+
+  for (uint32_t level = 0; level < indexCount; level++) {
+    KTX2LevelIndex levelIndex;
+    memcpy(&levelIndex, bytes + sizeof(KTX2Header) + sizeof(KTX2LevelIndex) * level, sizeof(KTX2LevelIndex));
+
+    if (levelIndex.byteOffset > size || levelIndex.byteLength > size - levelIndex.byteOffset) {
+      ev_log_error("[KTX2] Level %u is out of bounds", level);
+      return false;
+    }
+
+    // The copy to the image reads whole blocks covering the level's extent.
+    // Compared by division so that huge extents can't overflow.
+    uint64_t blocksWide = ((uint64_t)MAX(header.pixelWidth >> level, 1) + blockWidth - 1) / blockWidth;
+    uint64_t blocksHigh = ((uint64_t)MAX(header.pixelHeight >> level, 1) + blockHeight - 1) / blockHeight;
+    if (levelIndex.byteLength / blockBytes / blocksWide < blocksHigh) {
+      ev_log_error("[KTX2] Level %u is smaller than its extent", level);
+      return false;
+    }
+
+    texture->levels[level] = bytes + levelIndex.byteOffset;
+    texture->levelSizes[level] = blocksWide * blocksHigh * blockBytes;
+  }
+
+  return true;
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <Vulkan.h>
+
+typedef struct {
+  VkFormat format;
+  uint32_t width;
+  uint32_t height;
+
+  // Zero when the container asks for the mip chain to be generated
+  uint32_t levelCount;
+  const void *levels[TEXTURE_MAX_MIPS];
+  // Exact size of the blocks covering each level's extent, checked to lie
+  // inside the file
+  unsigned long long levelSizes[TEXTURE_MAX_MIPS];
+} KTX2Texture;
+
+// Parses an in-memory KTX2 container without copying its payload, the level
+// pointers stay valid as long as `data` does. Only single layer, single face
+// 2D textures without supercompression are accepted, and no more levels than
+// the full mip chain of their extent.
+bool ev_ktx2_parse(const void *data, unsigned long long size, KTX2Texture *texture);
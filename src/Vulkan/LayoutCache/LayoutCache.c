@@ -0,0 +1,158 @@
+#include <LayoutCache/LayoutCache.h>
+
+#include <stdlib.h>
+#include <Vulkan_utils.h>
+#include <DescriptorManager.h>
+#include <ContentHash/ContentHash.h>
+#include <evol/threads/evolpthreads.h>
+
+#define LAYOUTCACHE_MAX_SETS 4
+
+typedef struct {
+  uint64_t hash;
+  vec(VkDescriptorSetLayoutBinding) bindings;
+  VkDescriptorSetLayout layout;
+} CachedSetLayout;
+
+typedef struct {
+  uint32_t setLayoutCount;
+  VkDescriptorSetLayout setLayouts[LAYOUTCACHE_MAX_SETS];
+  VkPushConstantRange pushConstantRange;
+} PipelineLayoutKey;
+
+typedef struct {
+  uint64_t hash;
+  PipelineLayoutKey key;
+  VkPipelineLayout layout;
+} CachedPipelineLayout;
+
+struct {
+  // Pipelines are built on the worker threads
+  pthread_mutex_t mutex;
+  vec(CachedSetLayout) setLayouts;
+  vec(CachedPipelineLayout) pipelineLayouts;
+} LayoutCacheData;
+
+#define DATA(X) LayoutCacheData.X
+
+static void ev_layoutcache_destroysetlayout(CachedSetLayout *entry)
+{
+  ev_vulkan_destroysetlayout(entry->layout);
+  vec_fini(entry->bindings);
+}
+
+static void ev_layoutcache_destroypipelinelayout(CachedPipelineLayout *entry)
+{
+  ev_vulkan_destroypipelinelayout(entry->layout);
+}
+
+static int ev_layoutcache_comparebindings(const void *a, const void *b)
+{
+  uint32_t lhs = ((const VkDescriptorSetLayoutBinding*)a)->binding;
+  uint32_t rhs = ((const VkDescriptorSetLayoutBinding*)b)->binding;
+  return (lhs > rhs) - (lhs < rhs);
+}
+
+void ev_layoutcache_init()
+{
+  pthread_mutex_init(&DATA(mutex), NULL);
+  DATA(setLayouts) = vec_init(CachedSetLayout, NULL, ev_layoutcache_destroysetlayout);
+  DATA(pipelineLayouts) = vec_init(CachedPipelineLayout, NULL, ev_layoutcache_destroypipelinelayout);
+}
+
+void ev_layoutcache_deinit()
+{
+  // Pipeline layouts go first, they were created from the set layouts
+  vec_fini(DATA(pipelineLayouts));
+  vec_fini(DATA(setLayouts));
+  pthread_mutex_destroy(&DATA(mutex));
+}
+
+VkDescriptorSetLayout ev_layoutcache_getsetlayout(uint32_t bindingCount, const VkDescriptorSetLayoutBinding *bindings)
+{
+  vec(VkDescriptorSetLayoutBinding) canonical = vec_init(VkDescriptorSetLayoutBinding);
+  vec_setlen(&canonical, bindingCount);
+  for (uint32_t i = 0; i < bindingCount; i++) {
+    DEBUG_ASSERT(bindings[i].pImmutableSamplers == NULL);
+    canonical[i] = (VkDescriptorSetLayoutBinding) {
+      .binding = bindings[i].binding,
+      .descriptorType = bindings[i].descriptorType,
+      .descriptorCount = bindings[i].descriptorCount,
+      .stageFlags = bindings[i].stageFlags,
+    };
+  }
+  qsort(canonical, bindingCount, sizeof(VkDescriptorSetLayoutBinding), ev_layoutcache_comparebindings);
+
+  unsigned long long size = (unsigned long long)bindingCount * sizeof(VkDescriptorSetLayoutBinding);
+  uint64_t hash = ev_contenthash_compute(canonical, size, bindingCount);
+
+  pthread_mutex_lock(&DATA(mutex));
+
+  for (size_t i = 0; i < vec_len(DATA(setLayouts)); i++) {
+    CachedSetLayout *entry = &DATA(setLayouts)[i];
+    if (entry->hash == hash && vec_len(entry->bindings) == bindingCount && !memcmp(entry->bindings, canonical, size)) {
+      pthread_mutex_unlock(&DATA(mutex));
+      vec_fini(canonical);
+      return entry->layout;
+    }
+  }
+
+  CachedSetLayout entry = {
+    .hash = hash,
+    .bindings = canonical,
+  };
+
+  VkDescriptorSetLayoutCreateInfo createInfo = {
+    .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+    .bindingCount = bindingCount,
+    .pBindings = canonical,
+  };
+  VK_ASSERT(vkCreateDescriptorSetLayout(ev_vulkan_getlogicaldevice(), &createInfo, NULL, &entry.layout));
+  ev_descriptormanager_registerlayout(entry.layout, bindingCount, canonical);
+  vec_push(&DATA(setLayouts), &entry);
+
+  pthread_mutex_unlock(&DATA(mutex));
+  return entry.layout;
+}
+
+VkPipelineLayout ev_layoutcache_getpipelinelayout(uint32_t setLayoutCount, const VkDescriptorSetLayout *setLayouts, const VkPushConstantRange *pushConstantRange)
+{
+  DEBUG_ASSERT(setLayoutCount <= LAYOUTCACHE_MAX_SETS);
+
+  PipelineLayoutKey key;
+  memset(&key, 0, sizeof(PipelineLayoutKey));
+  key.setLayoutCount = setLayoutCount;
+  memcpy(key.setLayouts, setLayouts, setLayoutCount * sizeof(VkDescriptorSetLayout));
+  if (pushConstantRange) {
+    key.pushConstantRange = *pushConstantRange;
+  }
+  uint64_t hash = ev_contenthash_compute(&key, sizeof(PipelineLayoutKey), 0);
+
+  pthread_mutex_lock(&DATA(mutex));
+
+  for (size_t i = 0; i < vec_len(DATA(pipelineLayouts)); i++) {
+    CachedPipelineLayout *entry = &DATA(pipelineLayouts)[i];
+    if (entry->hash == hash && !memcmp(&entry->key, &key, sizeof(PipelineLayoutKey))) {
+      pthread_mutex_unlock(&DATA(mutex));
+      return entry->layout;
+    }
+  }
+
+  CachedPipelineLayout entry = {
+    .hash = hash,
+    .key = key,
+  };
+
+  VkPipelineLayoutCreateInfo createInfo = {
+    .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+    .setLayoutCount = setLayoutCount,
+    .pSetLayouts = key.setLayouts,
+    .pushConstantRangeCount = pushConstantRange ? 1 : 0,
+    .pPushConstantRanges = &key.pushConstantRange,
+  };
+  VK_ASSERT(vkCreatePipelineLayout(ev_vulkan_getlogicaldevice(), &createInfo, NULL, &entry.layout));
+  vec_push(&DATA(pipelineLayouts), &entry);
+
+  pthread_mutex_unlock(&DATA(mutex));
+  return entry.layout;
+}
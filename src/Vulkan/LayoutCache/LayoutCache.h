@@ -0,0 +1,17 @@
+#pragma once
+
+#include <Vulkan.h>
+
+void ev_layoutcache_init();
+
+// Destroys every cached set and pipeline layout
+void ev_layoutcache_deinit();
+
+// Returns a set layout for the given bindings. The list is canonicalized
+// (sorted by binding number) before lookup, so the order they were gathered
+// in doesn't matter. Bindings must be unique and not use immutable samplers.
+VkDescriptorSetLayout ev_layoutcache_getsetlayout(uint32_t bindingCount, const VkDescriptorSetLayoutBinding *bindings);
+
+// Returns a pipeline layout for the given set layouts and optional push
+// constant range. Pipelines that get the same layout can share bound sets.
+VkPipelineLayout ev_layoutcache_getpipelinelayout(uint32_t setLayoutCount, const VkDescriptorSetLayout *setLayouts, const VkPushConstantRange *pushConstantRange);
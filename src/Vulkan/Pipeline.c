@@ -5,38 +5,128 @@
 #include <evol/common/ev_macros.h>
 #include <vec.h>
 #include <Vulkan_utils.h>
-#include <spvref/spirv_reflect.h>
+#include <PipelineCache/PipelineCache.h>
+#include <ShaderCache/ShaderCache.h>
+#include <LayoutCache/LayoutCache.h>
+#include <GraphicsLibrary/GraphicsLibrary.h>
 #include <evol/common/ev_log.h>
 
 typedef struct
 {
   uint32_t set_number;
-  VkDescriptorSetLayoutCreateInfo create_info;
   vec(VkDescriptorSetLayoutBinding) bindings;
-  vec(uint32_t*) bindingNames;
 } DescriptorSetLayoutData;
 
-void ev_pipeline_createshadermodule(Shader code, VkShaderModule *shaderModule)
-{
-  VkShaderModuleCreateInfo shaderModuleCreateInfo = {
-    .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
-    .codeSize = code.length,
-    .pCode = code.data,
-  };
+void ev_pipeline_reflectlayout(uint32_t stageCount, const CachedShader **shaders, vec(DescriptorSet) overideSets, Pipeline *pipeline);
 
-  VK_ASSERT(vkCreateShaderModule(ev_vulkan_getlogicaldevice(), &shaderModuleCreateInfo, NULL, shaderModule));
+// Parts are keyed by handles only, so pipelines that bring their own
+// fixed-function state are always compiled monolithically
+static bool ev_pipeline_canuselibraries(const EvGraphicsPipelineCreateInfo *evCreateInfo)
+{
+  return ev_vulkan_hasgraphicspipelinelibrary()
+      && evCreateInfo->stageCount <= GRAPHICS_LIBRARY_MAX_STAGES
+      && !evCreateInfo->pVertexInputState
+      && !evCreateInfo->pInputAssemblyState
+      && !evCreateInfo->pTessellationState
+      && !evCreateInfo->pViewportState
+      && !evCreateInfo->pRasterizationState
+      && !evCreateInfo->pMultisampleState
+      && !evCreateInfo->pDepthStencilState
+      && !evCreateInfo->pColorBlendState
+      && !evCreateInfo->pDynamicState;
 }
 
-void descriptorSetLayoutData_destr(DescriptorSetLayoutData *data)
+// Fetches the four parts of `createInfo` from the library cache and fast
+// links them
+static void ev_pipeline_linklibraries(const VkGraphicsPipelineCreateInfo *createInfo, const VkSpecializationInfo *specializationInfo, Pipeline *pipeline)
 {
-  vec_fini(data->bindings);
+  VkPipelineShaderStageCreateInfo preRasterizationStages[GRAPHICS_LIBRARY_MAX_STAGES];
+  VkPipelineShaderStageCreateInfo fragmentStages[GRAPHICS_LIBRARY_MAX_STAGES];
+  uint32_t preRasterizationStageCount = 0;
+  uint32_t fragmentStageCount = 0;
+
+  GraphicsLibraryKey keys[GRAPHICS_LIBRARY_COUNT];
+  memset(keys, 0, sizeof(keys));
+  for (uint32_t part = 0; part < GRAPHICS_LIBRARY_COUNT; part++)
+    keys[part].part = part;
+
+  for (uint32_t stgIndex = 0; stgIndex < createInfo->stageCount; stgIndex++)
+  {
+    const VkPipelineShaderStageCreateInfo *stage = &createInfo->pStages[stgIndex];
+    if (stage->stage == VK_SHADER_STAGE_FRAGMENT_BIT)
+    {
+      keys[GRAPHICS_LIBRARY_FRAGMENT_SHADER].modules[fragmentStageCount] = stage->module;
+      fragmentStages[fragmentStageCount++] = *stage;
+    }
+    else
+    {
+      keys[GRAPHICS_LIBRARY_PRE_RASTERIZATION].modules[preRasterizationStageCount] = stage->module;
+      preRasterizationStages[preRasterizationStageCount++] = *stage;
+    }
+  }
+
+  uint64_t specializationHash = ev_graphicslibrary_hashspecialization(specializationInfo);
+  for (uint32_t part = GRAPHICS_LIBRARY_PRE_RASTERIZATION; part < GRAPHICS_LIBRARY_COUNT; part++)
+  {
+    keys[part].renderPass = createInfo->renderPass;
+    keys[part].subpass = createInfo->subpass;
+  }
+  keys[GRAPHICS_LIBRARY_PRE_RASTERIZATION].layout = createInfo->layout;
+  keys[GRAPHICS_LIBRARY_PRE_RASTERIZATION].specializationHash = specializationHash;
+  keys[GRAPHICS_LIBRARY_FRAGMENT_SHADER].layout = createInfo->layout;
+  keys[GRAPHICS_LIBRARY_FRAGMENT_SHADER].specializationHash = specializationHash;
+
+  VkGraphicsPipelineCreateInfo partCreateInfos[GRAPHICS_LIBRARY_COUNT] = {
+    [GRAPHICS_LIBRARY_VERTEX_INPUT] = {
+      .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+      .pVertexInputState = createInfo->pVertexInputState,
+      .pInputAssemblyState = createInfo->pInputAssemblyState,
+    },
+    [GRAPHICS_LIBRARY_PRE_RASTERIZATION] = {
+      .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+      .stageCount = preRasterizationStageCount,
+      .pStages = preRasterizationStages,
+      .pViewportState = createInfo->pViewportState,
+      .pRasterizationState = createInfo->pRasterizationState,
+      .pDynamicState = createInfo->pDynamicState,
+      .layout = createInfo->layout,
+      .renderPass = createInfo->renderPass,
+      .subpass = createInfo->subpass,
+    },
+    [GRAPHICS_LIBRARY_FRAGMENT_SHADER] = {
+      .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+      .stageCount = fragmentStageCount,
+      .pStages = fragmentStages,
+      .pMultisampleState = createInfo->pMultisampleState,
+      .pDepthStencilState = createInfo->pDepthStencilState,
+      .pDynamicState = createInfo->pDynamicState,
+      .layout = createInfo->layout,
+      .renderPass = createInfo->renderPass,
+      .subpass = createInfo->subpass,
+    },
+    [GRAPHICS_LIBRARY_FRAGMENT_OUTPUT] = {
+      .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+      .pMultisampleState = createInfo->pMultisampleState,
+      .pColorBlendState = createInfo->pColorBlendState,
+      .pDynamicState = createInfo->pDynamicState,
+      .renderPass = createInfo->renderPass,
+      .subpass = createInfo->subpass,
+    },
+  };
+
+  for (uint32_t part = 0; part < GRAPHICS_LIBRARY_COUNT; part++)
+    pipeline->libraries[part] = ev_graphicslibrary_get(&keys[part], &partCreateInfos[part]);
+
+  pipeline->pipeline = ev_graphicslibrary_link(pipeline->libraries, createInfo->layout, false);
 }
 
 void ev_pipeline_build(EvGraphicsPipelineCreateInfo evCreateInfo, vec(DescriptorSet) overideSets, Pipeline *pipeline)
 {
-  VkShaderModule shaderModules[evCreateInfo.stageCount];
+  const CachedShader *shaders[evCreateInfo.stageCount];
   VkPipelineShaderStageCreateInfo shaderStageCreateInfos[evCreateInfo.stageCount];
 
+  memset(pipeline->libraries, 0, sizeof(pipeline->libraries));
+
   {
     if (evCreateInfo.stageCount == 0) return;
     if (evCreateInfo.renderPass == NULL) return;
@@ -44,17 +134,18 @@ void ev_pipeline_build(EvGraphicsPipelineCreateInfo evCreateInfo, vec(Descriptor
 
   for (size_t stgIndex = 0; stgIndex < evCreateInfo.stageCount; stgIndex++)
   {
-    ev_pipeline_createshadermodule(evCreateInfo.pShaders[stgIndex], &shaderModules[stgIndex]);
+    shaders[stgIndex] = ev_shadercache_get(evCreateInfo.pShaders[stgIndex]);
 
     shaderStageCreateInfos[stgIndex] = (VkPipelineShaderStageCreateInfo){
       .sType  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
       .stage  = evCreateInfo.pShaders[stgIndex].stage,
-      .module = shaderModules[stgIndex],
-      .pName  = "main"
+      .module = shaders[stgIndex]->module,
+      .pName  = "main",
+      .pSpecializationInfo = evCreateInfo.pSpecializationInfo,
     };
   }
 
-  ev_pipeline_reflectlayout(evCreateInfo, overideSets, pipeline);
+  ev_pipeline_reflectlayout(evCreateInfo.stageCount, shaders, overideSets, pipeline);
 
   VkPipelineVertexInputStateCreateInfo pipelineVertexInputState ={
     .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
@@ -142,7 +233,7 @@ void ev_pipeline_build(EvGraphicsPipelineCreateInfo evCreateInfo, vec(Descriptor
   VkGraphicsPipelineCreateInfo graphicsPipelinesCreateInfo =
   {
     .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
-    .flags = VK_PIPELINE_CREATE_ALLOW_DERIVATIVES_BIT,
+    .flags = evCreateInfo.flags,
 
     .stageCount = evCreateInfo.stageCount,
     .pStages = shaderStageCreateInfos,
@@ -161,94 +252,51 @@ void ev_pipeline_build(EvGraphicsPipelineCreateInfo evCreateInfo, vec(Descriptor
     .pDynamicState = evCreateInfo.pDynamicState == 0 ? &pipelineDynamicState : evCreateInfo.pDynamicState,
   };
 
+  if (ev_pipeline_canuselibraries(&evCreateInfo))
+  {
+    ev_pipeline_linklibraries(&graphicsPipelinesCreateInfo, evCreateInfo.pSpecializationInfo, pipeline);
+    return;
+  }
+
   VK_ASSERT(
     vkCreateGraphicsPipelines(
-      ev_vulkan_getlogicaldevice(), NULL,
+      ev_vulkan_getlogicaldevice(), ev_pipelinecache_get(),
       1,
       &graphicsPipelinesCreateInfo, NULL,
       &pipeline->pipeline)
     );
-
-  for (size_t i = 0; i < ARRAYSIZE(shaderModules); i++)
-    ev_vulkan_destroyshadermodule(shaderModules[i]);
+  ev_pipelinecache_markdirty();
 }
 
-void ev_pipeline_reflectStages(EvGraphicsPipelineCreateInfo pipelineCreateInfo, VkPushConstantRange* pc, DescriptorSetLayoutData* set_datalayouts)
+// Gathers the reflected set layouts and push constants of every stage
+void ev_pipeline_reflectStages(uint32_t stageCount, const CachedShader **shaders, VkPushConstantRange* pc, DescriptorSetLayoutData* set_datalayouts)
 {
-  for (size_t stageIndex = 0; stageIndex < pipelineCreateInfo.stageCount; stageIndex++)
+  for (size_t stageIndex = 0; stageIndex < stageCount; stageIndex++)
   {
-    SpvReflectShaderModule spvmodule;
-    SpvReflectResult result = spvReflectCreateShaderModule(pipelineCreateInfo.pShaders[stageIndex].length, pipelineCreateInfo.pShaders[stageIndex].data, &spvmodule);
-
-    uint32_t count = 0;
-    result = spvReflectEnumerateDescriptorSets(&spvmodule, &count, NULL);
-    assert(result == SPV_REFLECT_RESULT_SUCCESS);
+    const CachedShader *shader = shaders[stageIndex];
 
-    vec(SpvReflectDescriptorSet*) sets = vec_init(SpvReflectDescriptorSet*);
-    vec_setlen(&sets, count);
-    result = spvReflectEnumerateDescriptorSets(&spvmodule, &count, sets);
-    assert(result == SPV_REFLECT_RESULT_SUCCESS);
-
-    for (size_t setIndex = 0; setIndex < vec_len(sets); setIndex++)
+    for (size_t setIndex = 0; setIndex < vec_len(shader->setLayouts); setIndex++)
     {
-      SpvReflectDescriptorSet* set = sets[setIndex];
-
       DescriptorSetLayoutData layout = {
-        .bindings = vec_init(VkDescriptorSetLayoutBinding),
-        .bindingNames = vec_init(uint32_t*),
+        .set_number = shader->setLayouts[setIndex].setNumber,
+        .bindings = shader->setLayouts[setIndex].bindings,
       };
-      vec_setlen(&layout.bindings, set->binding_count);
-      vec_setlen(&layout.bindingNames, set->binding_count);
-
-      for (uint32_t i_binding = 0; i_binding < set->binding_count; ++i_binding)
-      {
-        const SpvReflectDescriptorBinding refl_binding = *(set->bindings[i_binding]);
-        VkDescriptorSetLayoutBinding *layout_binding = &layout.bindings[i_binding];
-        layout_binding->binding = refl_binding.binding;
-        layout_binding->descriptorType = (VkDescriptorType)refl_binding.descriptor_type;
-        layout_binding->descriptorCount = 1;
-        layout.bindingNames[i_binding] = refl_binding.name;
-
-        for (uint32_t i_dim = 0; i_dim < refl_binding.array.dims_count; ++i_dim)
-        {
-          layout_binding->descriptorCount *= refl_binding.array.dims[i_dim];
-        }
-        layout_binding->stageFlags = (VkShaderStageFlagBits)spvmodule.shader_stage;
-      }
-
-      layout.set_number = set->set;
-      layout.create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-      layout.create_info.bindingCount = set->binding_count;
-      layout.create_info.pBindings = layout.bindings;
-
       vec_push(set_datalayouts, &layout);
     }
 
-    //sprv pushconstant reflection
-    result = spvReflectEnumeratePushConstants(&spvmodule, &count, NULL);
-    assert(result == SPV_REFLECT_RESULT_SUCCESS);
-
-    SpvReflectBlockVariable* pconstant;
-
-    result = spvReflectEnumeratePushConstants(&spvmodule, &count, &pconstant);
-    assert(result == SPV_REFLECT_RESULT_SUCCESS);
-
-    if (count > 0)
+    if (shader->pushConstantRange.size > 0)
     {
-        pc->offset = pconstant->offset;
-        pc->size = pconstant->size;
-        pc->stageFlags = VK_SHADER_STAGE_ALL_GRAPHICS;
+      *pc = shader->pushConstantRange;
     }
-
-    vec_fini(sets);
   }
 }
 
-void ev_pipeline_reflectlayout(EvGraphicsPipelineCreateInfo pipelineCreateInfo, vec(DescriptorSet) overideSets, Pipeline *pipeline)
+void ev_pipeline_reflectlayout(uint32_t stageCount, const CachedShader **shaders, vec(DescriptorSet) overideSets, Pipeline *pipeline)
 {
   VkPushConstantRange pc = { 0 };
-  vec(DescriptorSetLayoutData) setLayouts_data = vec_init(DescriptorSetLayoutData, descriptorSetLayoutData_destr);
-  ev_pipeline_reflectStages(pipelineCreateInfo, &pc, &setLayouts_data);
+  // The bindings are borrowed from the shader cache
+  vec(DescriptorSetLayoutData) setLayouts_data = vec_init(DescriptorSetLayoutData);
+  ev_pipeline_reflectStages(stageCount, shaders, &pc, &setLayouts_data);
 
   vec_setcapacity(&pipeline->pSets, 4);
 
@@ -256,13 +304,7 @@ void ev_pipeline_reflectlayout(EvGraphicsPipelineCreateInfo pipelineCreateInfo,
   for (size_t i = 0; i < overrideCount; i++)
     vec_push(&pipeline->pSets, &overideSets[i]);
 
-  DescriptorSetLayoutData final_setLayouts_data[4] =
-  {
-    [0] = { .bindings = vec_init(VkDescriptorSetLayoutBinding) },
-    [1] = { .bindings = vec_init(VkDescriptorSetLayoutBinding) },
-    [2] = { .bindings = vec_init(VkDescriptorSetLayoutBinding) },
-    [3] = { .bindings = vec_init(VkDescriptorSetLayoutBinding) },
-  };
+  vec(VkDescriptorSetLayoutBinding) setBindings = vec_init(VkDescriptorSetLayoutBinding);
 
   for (int i = overrideCount; i < 4; i++)
   {
@@ -270,7 +312,7 @@ void ev_pipeline_reflectlayout(EvGraphicsPipelineCreateInfo pipelineCreateInfo,
     set.layout = VK_NULL_HANDLE;
     set.pBindings = vec_init(Binding);
 
-    DescriptorSetLayoutData final_setLayout = final_setLayouts_data[i];
+    vec_clear(setBindings);
 
     for (size_t setLayoutIndex = 0; setLayoutIndex < vec_len(setLayouts_data); setLayoutIndex++)
     {
@@ -280,59 +322,48 @@ void ev_pipeline_reflectlayout(EvGraphicsPipelineCreateInfo pipelineCreateInfo,
       {
         for(size_t bindingIdx = 0; bindingIdx < vec_len(setLayout.bindings); bindingIdx++)
         {
-          vec_push(&final_setLayout.bindings, &(VkDescriptorSetLayoutBinding) {
-            .binding          = setLayout.bindings[bindingIdx].binding,
-            .descriptorType   = setLayout.bindings[bindingIdx].descriptorType,
-            .descriptorCount  = setLayout.bindings[bindingIdx].descriptorCount,
-            .stageFlags       = setLayout.bindings[bindingIdx].stageFlags,
-            .pImmutableSamplers = 0
-          });
+          VkDescriptorSetLayoutBinding binding = setLayout.bindings[bindingIdx];
+
+          // Bindings used by more than one stage are merged into one entry
+          size_t existing = 0;
+          while (existing < vec_len(setBindings) && setBindings[existing].binding != binding.binding)
+            existing++;
 
-          vec_push(&set.pBindings, &(VkDescriptorSetLayoutBinding) {
-            .binding          = setLayout.bindings[bindingIdx].binding,
-            .descriptorType   = setLayout.bindings[bindingIdx].descriptorType,
-            .descriptorCount  = setLayout.bindings[bindingIdx].descriptorCount,
-            .stageFlags       = setLayout.bindings[bindingIdx].stageFlags,
-            .pImmutableSamplers = 0
+          if (existing < vec_len(setBindings))
+          {
+            setBindings[existing].stageFlags |= binding.stageFlags;
+            continue;
+          }
+
+          vec_push(&setBindings, &binding);
+
+          vec_push(&set.pBindings, &(Binding) {
+            .binding = binding.binding,
+            .type    = binding.descriptorType,
           });
         }
       }
     }
 
-    final_setLayout.set_number = i;
-    final_setLayout.create_info = (VkDescriptorSetLayoutCreateInfo) {
-      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
-      .bindingCount = vec_len(final_setLayout.bindings),
-      .pBindings = final_setLayout.bindings,
-      .flags = 0,
-      .pNext = 0,
-    };
-
-    if (final_setLayout.create_info.bindingCount > 0)
+    if (vec_len(setBindings) > 0)
     {
-      //here you should retrieve all things
-      VK_ASSERT(vkCreateDescriptorSetLayout(ev_vulkan_getlogicaldevice(), &final_setLayout.create_info, NULL, &set.layout));
+      // Layouts are owned by the layout cache
+      set.layout = ev_layoutcache_getsetlayout(vec_len(setBindings), setBindings);
 
       vec_push(&pipeline->pSets, &set);
     }
+    else
+    {
+      vec_fini(set.pBindings);
+    }
   }
+  vec_fini(setBindings);
 
-  VkDescriptorSetLayout setLayouts[4] = {
-    pipeline->pSets[0].layout,
-    pipeline->pSets[1].layout,
-    pipeline->pSets[2].layout,
-    pipeline->pSets[3].layout,
-  };
-
-  VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {
-    .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
-    .setLayoutCount = vec_len(pipeline->pSets),
-    .pSetLayouts = setLayouts,
-    .pushConstantRangeCount = pc.size > 0 ? 1:0,
-    .pPushConstantRanges = &pc,
-  };
+  VkDescriptorSetLayout setLayouts[4];
+  for (size_t i = 0; i < vec_len(pipeline->pSets); i++)
+    setLayouts[i] = pipeline->pSets[i].layout;
 
-  VK_ASSERT(vkCreatePipelineLayout(ev_vulkan_getlogicaldevice(), &pipelineLayoutCreateInfo, NULL, &pipeline->pipelineLayout));
+  pipeline->pipelineLayout = ev_layoutcache_getpipelinelayout(vec_len(pipeline->pSets), setLayouts, pc.size > 0 ? &pc : NULL);
 
   vec_fini(setLayouts_data);
 }
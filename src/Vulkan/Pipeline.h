@@ -9,6 +9,8 @@ typedef struct
 {
   U32                                              stageCount;
   Shader*                                          pShaders;
+  // Applied to every stage, may be NULL
+  const VkSpecializationInfo*                      pSpecializationInfo;
 
   VkRenderPass                                     renderPass;
 
@@ -30,4 +32,8 @@ typedef struct
   int32_t                                          basePipelineIndex;
 } EvGraphicsPipelineCreateInfo;
 
-void ev_pipeline_build(EvGraphicsPipelineCreateInfo evCreateInfo, vec(DescriptorSet) overideSets, Pipeline *material);
+// Pipelines that only use the default fixed-function state are fast linked
+// from graphics pipeline libraries when the device supports them, in which
+// case `pipeline->libraries` is filled in and the pipeline should eventually
+// be replaced by its link time optimized equivalent.
+void ev_pipeline_build(EvGraphicsPipelineCreateInfo evCreateInfo, vec(DescriptorSet) overideSets, Pipeline *pipeline);
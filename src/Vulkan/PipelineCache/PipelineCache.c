@@ -0,0 +1,187 @@
+#include <PipelineCache/PipelineCache.h>
+
+#include <stdio.h>
+#include <stdatomic.h>
+#include <evstr.h>
+#include <Vulkan_utils.h>
+#include <ContentHash/ContentHash.h>
+#include <evol/common/ev_log.h>
+
+#define PIPELINECACHE_MAGIC   0x43505645 // "EVPC"
+#define PIPELINECACHE_VERSION 1
+
+// Drivers validate their own blob as well, but not every driver does it
+// thoroughly. The header lets us throw away stale data without ever handing
+// it to the driver.
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t vendorID;
+  uint32_t deviceID;
+  uint32_t driverVersion;
+  uint8_t  pipelineCacheUUID[VK_UUID_SIZE];
+  uint64_t dataSize;
+  uint64_t dataHash;
+} PipelineCacheFileHeader;
+
+struct {
+  VkPipelineCache cache;
+  evstring path;
+  // Set by pipeline builds on the worker threads
+  atomic_bool dirty;
+  // Hash and size of the blob that is on disk, saving it again is skipped
+  // when builds only hit the cache
+  uint64_t savedHash;
+  size_t savedSize;
+} PipelineCacheData;
+
+#define DATA(X) PipelineCacheData.X
+
+static void ev_pipelinecache_buildheader(PipelineCacheFileHeader *header)
+{
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(ev_vulkan_getphysicaldevice(), &properties);
+
+  memset(header, 0, sizeof(PipelineCacheFileHeader));
+  header->magic = PIPELINECACHE_MAGIC;
+  header->version = PIPELINECACHE_VERSION;
+  header->vendorID = properties.vendorID;
+  header->deviceID = properties.deviceID;
+  header->driverVersion = properties.driverVersion;
+  memcpy(header->pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE);
+}
+
+// Returns the cache blob stored in the file if it matches the current device
+static void *ev_pipelinecache_readfile(const char *path, size_t *dataSize)
+{
+  FILE *file = fopen(path, "rb");
+  if (!file) {
+    return NULL;
+  }
+
+  long fileSize = -1;
+  if (fseek(file, 0, SEEK_END) == 0) {
+    fileSize = ftell(file);
+  }
+  rewind(file);
+
+  PipelineCacheFileHeader expected, header;
+  ev_pipelinecache_buildheader(&expected);
+
+  void *data = NULL;
+  if (fileSize >= (long)sizeof(header) && fread(&header, sizeof(header), 1, file) == 1) {
+    // Only the device fields are compared, the blob is checked on its own
+    expected.dataSize = header.dataSize;
+    expected.dataHash = header.dataHash;
+
+    if (!memcmp(&header, &expected, sizeof(PipelineCacheFileHeader)) && header.dataSize > 0) {
+      if (header.dataSize > (unsigned long long)fileSize - sizeof(header)) {
+        ev_log_warn("[PipelineCache] %s is truncated, starting with an empty cache", path);
+      } else if (!(data = malloc(header.dataSize))) {
+        ev_log_warn("[PipelineCache] Couldn't allocate %llu bytes for %s, starting with an empty cache", (unsigned long long)header.dataSize, path);
+      } else if (fread(data, header.dataSize, 1, file) != 1 || ev_contenthash_compute(data, header.dataSize, 0) != header.dataHash) {
+        ev_log_warn("[PipelineCache] %s is corrupted, starting with an empty cache", path);
+        free(data);
+        data = NULL;
+      }
+    } else {
+      ev_log_info("[PipelineCache] %s was written by a different device or driver, starting with an empty cache", path);
+    }
+  }
+  fclose(file);
+
+  *dataSize = data ? header.dataSize : 0;
+  if (data) {
+    DATA(savedHash) = header.dataHash;
+    DATA(savedSize) = header.dataSize;
+  }
+  return data;
+}
+
+void ev_pipelinecache_init(const char *path)
+{
+  DATA(path) = evstring_new(path);
+  atomic_init(&DATA(dirty), false);
+  DATA(savedHash) = 0;
+  DATA(savedSize) = 0;
+
+  size_t dataSize;
+  void *data = ev_pipelinecache_readfile(path, &dataSize);
+
+  VkPipelineCacheCreateInfo createInfo = {
+    .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+    .initialDataSize = dataSize,
+    .pInitialData = data,
+  };
+  VK_ASSERT(vkCreatePipelineCache(ev_vulkan_getlogicaldevice(), &createInfo, NULL, &DATA(cache)));
+
+  if (data) {
+    ev_log_debug("[PipelineCache] Loaded %llu bytes from %s", (unsigned long long)dataSize, path);
+    free(data);
+  }
+}
+
+void ev_pipelinecache_deinit()
+{
+  ev_pipelinecache_save();
+
+  vkDestroyPipelineCache(ev_vulkan_getlogicaldevice(), DATA(cache), NULL);
+  evstring_free(DATA(path));
+}
+
+VkPipelineCache ev_pipelinecache_get()
+{
+  return DATA(cache);
+}
+
+void ev_pipelinecache_markdirty()
+{
+  atomic_store(&DATA(dirty), true);
+}
+
+void ev_pipelinecache_save()
+{
+  if (!atomic_exchange(&DATA(dirty), false)) {
+    return;
+  }
+
+  size_t dataSize;
+  VK_ASSERT(vkGetPipelineCacheData(ev_vulkan_getlogicaldevice(), DATA(cache), &dataSize, NULL));
+  void *data = malloc(dataSize);
+  VK_ASSERT(vkGetPipelineCacheData(ev_vulkan_getlogicaldevice(), DATA(cache), &dataSize, data));
+
+  PipelineCacheFileHeader header;
+  ev_pipelinecache_buildheader(&header);
+  header.dataSize = dataSize;
+  header.dataHash = ev_contenthash_compute(data, dataSize, 0);
+
+  // Builds mark the cache dirty whether or not the driver found the
+  // pipeline in it, only a changed blob is worth rewriting
+  if (dataSize == DATA(savedSize) && header.dataHash == DATA(savedHash)) {
+    free(data);
+    return;
+  }
+
+  // Written next to the old file first, so that a crash never leaves a
+  // truncated cache behind
+  evstring tmpPath = evstring_newfmt("%s.tmp", DATA(path));
+  FILE *file = fopen(tmpPath, "wb");
+  if (file) {
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1 && fwrite(data, dataSize, 1, file) == 1;
+    written &= fclose(file) == 0;
+
+    if (written && rename(tmpPath, DATA(path)) == 0) {
+      DATA(savedHash) = header.dataHash;
+      DATA(savedSize) = dataSize;
+      ev_log_debug("[PipelineCache] Saved %llu bytes to %s", (unsigned long long)dataSize, DATA(path));
+    } else {
+      ev_log_warn("[PipelineCache] Couldn't write %s", DATA(path));
+      remove(tmpPath);
+    }
+  } else {
+    ev_log_warn("[PipelineCache] Couldn't open %s for writing", tmpPath);
+  }
+
+  evstring_free(tmpPath);
+  free(data);
+}
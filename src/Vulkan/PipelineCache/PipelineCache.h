@@ -0,0 +1,19 @@
+#pragma once
+
+#include <Vulkan.h>
+
+// Creates the pipeline cache, seeded from the file at `path` when it was
+// written by the same device and driver. Otherwise starts out empty.
+void ev_pipelinecache_init(const char *path);
+
+// Saves the cache and destroys it
+void ev_pipelinecache_deinit();
+
+VkPipelineCache ev_pipelinecache_get();
+
+// Flags the cache as holding pipelines that aren't on disk yet
+void ev_pipelinecache_markdirty();
+
+// Writes the cache back to disk if any pipeline was built since the last save
+// and the driver's blob actually changed
+void ev_pipelinecache_save();
@@ -4,6 +4,7 @@
 
 #include <Vulkan.h>
 #include <Vulkan_utils.h>
+#include <SamplerCache/SamplerCache.h>
 #include <evol/common/ev_log.h>
 
 void init_subpass(Subpass *subpass)
@@ -165,7 +166,7 @@ void createattachmenttexture(PassAttachment attachment, EvTexture *texture)
     .minLod = 0.0f,
     .maxLod = 0.0f,
   };
-  vkCreateSampler(ev_vulkan_getlogicaldevice(), &samplerCreateInfo, NULL, &texture->sampler);
+  texture->sampler = ev_samplercache_get(&samplerCreateInfo);
 }
 
 void ev_renderpass_build(uint32_t bufferingMode, VkExtent3D passExtent, uint32_t attachmentsCount, PassAttachment* attachments, uint32_t subpassCount, uint32_t dependencyCount, VkSubpassDependency* dependencies, RenderPass *pass)
@@ -6,6 +6,7 @@
 #include <evol/threads/evolpthreads.h>
 
 #define SWAPCHAIN_MAX_IMAGES 5
+#define TEXTURE_MAX_MIPS 16
 
 typedef enum {
     VERTEXRESOURCE,
@@ -25,7 +26,7 @@ typedef struct EvTexturer
  {
      EvImage image;
      VkImageView imageView;
-     VkSampler sampler;
+     VkSampler sampler; // Owned by the sampler cache
  } EvTexture;
 
 typedef struct
@@ -84,17 +85,22 @@ typedef struct {
   uint32_t index;
 } ShaderData;
 
+// The buffer addresses are only pushed when buffer device address is enabled
 typedef struct {
   Matrix4x4 transform;
   uint32_t indexBufferIndex;
   uint32_t vertexBufferIndex;
   uint32_t materialIndex;
+  uint64_t indexBufferAddress;
+  uint64_t vertexBufferAddress;
 } MeshPushConstants;
 
 typedef struct {
   Matrix4x4 transform;
   uint32_t indexBufferIndex;
   uint32_t vertexBufferIndex;
+  uint64_t indexBufferAddress;
+  uint64_t vertexBufferAddress;
 } ShadowmapPushConstants;
 
 typedef struct {
@@ -105,6 +111,8 @@ typedef struct {
   void* data;
   size_t length;
   VkShaderStageFlags stage;
+  // Set for shaders mapped from the shader archive, which also owns `data`
+  const void* reflection;
 } Shader;
 
 typedef struct {
@@ -124,6 +132,10 @@ typedef struct {
   VkPipelineLayout pipelineLayout;
 
   vec(DescriptorSet) pSets;
+
+  // Set when `pipeline` was fast linked from graphics pipeline libraries,
+  // the libraries themselves are owned by the library cache
+  VkPipeline libraries[4];
 } Pipeline;
 
 typedef struct {
@@ -0,0 +1,95 @@
+#include <SamplerCache/SamplerCache.h>
+
+#include <Vulkan_utils.h>
+#include <evol/common/ev_log.h>
+
+typedef struct {
+  uint64_t hash;
+  VkSamplerCreateInfo key;
+  VkSampler sampler;
+} CachedSampler;
+
+struct {
+  vec(CachedSampler) samplers;
+} SamplerCacheData;
+
+#define DATA(X) SamplerCacheData.X
+
+static void ev_samplercache_destroysampler(CachedSampler *entry)
+{
+  vkDestroySampler(ev_vulkan_getlogicaldevice(), entry->sampler, NULL);
+}
+
+// Copies the state that affects sampling into a zeroed struct so that padding
+// bytes and pointers never take part in hashing/comparison
+static void ev_samplercache_buildkey(const VkSamplerCreateInfo *createInfo, VkSamplerCreateInfo *key)
+{
+  memset(key, 0, sizeof(VkSamplerCreateInfo));
+  key->sType                   = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+  key->flags                   = createInfo->flags;
+  key->magFilter               = createInfo->magFilter;
+  key->minFilter               = createInfo->minFilter;
+  key->mipmapMode              = createInfo->mipmapMode;
+  key->addressModeU            = createInfo->addressModeU;
+  key->addressModeV            = createInfo->addressModeV;
+  key->addressModeW            = createInfo->addressModeW;
+  key->mipLodBias              = createInfo->mipLodBias;
+  key->anisotropyEnable        = createInfo->anisotropyEnable;
+  key->maxAnisotropy           = createInfo->maxAnisotropy;
+  key->compareEnable           = createInfo->compareEnable;
+  key->compareOp               = createInfo->compareOp;
+  key->minLod                  = createInfo->minLod;
+  key->maxLod                  = createInfo->maxLod;
+  key->borderColor             = createInfo->borderColor;
+  key->unnormalizedCoordinates = createInfo->unnormalizedCoordinates;
+}
+
+// FNV-1a
+static uint64_t ev_samplercache_hash(const VkSamplerCreateInfo *key)
+{
+  const uint8_t *bytes = (const uint8_t*)key;
+  uint64_t hash = 0xcbf29ce484222325ull;
+  for (size_t i = 0; i < sizeof(VkSamplerCreateInfo); i++) {
+    hash ^= bytes[i];
+    hash *= 0x100000001b3ull;
+  }
+  return hash;
+}
+
+void ev_samplercache_init()
+{
+  DATA(samplers) = vec_init(CachedSampler, NULL, ev_samplercache_destroysampler);
+}
+
+void ev_samplercache_deinit()
+{
+  vec_fini(DATA(samplers));
+}
+
+VkSampler ev_samplercache_get(const VkSamplerCreateInfo *createInfo)
+{
+  DEBUG_ASSERT(createInfo->pNext == NULL);
+
+  VkSamplerCreateInfo key;
+  ev_samplercache_buildkey(createInfo, &key);
+  uint64_t hash = ev_samplercache_hash(&key);
+
+  // Scenes only ever use a handful of distinct samplers
+  for (size_t i = 0; i < vec_len(DATA(samplers)); i++) {
+    CachedSampler *entry = &DATA(samplers)[i];
+    if (entry->hash == hash && !memcmp(&entry->key, &key, sizeof(VkSamplerCreateInfo))) {
+      return entry->sampler;
+    }
+  }
+
+  CachedSampler entry = {
+    .hash = hash,
+    .key = key,
+  };
+  VK_ASSERT(vkCreateSampler(ev_vulkan_getlogicaldevice(), &key, NULL, &entry.sampler));
+  vec_push(&DATA(samplers), &entry);
+
+  ev_log_debug("[SamplerCache] Created sampler #%u", (uint32_t)vec_len(DATA(samplers)));
+
+  return entry.sampler;
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <Vulkan.h>
+
+void ev_samplercache_init();
+
+// Destroys every sampler that was handed out
+void ev_samplercache_deinit();
+
+// Returns a sampler matching `createInfo`, creating it on the first request.
+// Samplers are shared between textures and stay alive until deinit, so they
+// must never be destroyed by the caller. `pNext` chains are not supported.
+VkSampler ev_samplercache_get(const VkSamplerCreateInfo *createInfo);
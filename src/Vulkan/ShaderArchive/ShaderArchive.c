@@ -0,0 +1,200 @@
+#include <ShaderArchive/ShaderArchive.h>
+#include <ShaderArchive/ShaderArchive_format.h>
+
+#include <stdlib.h>
+#include <evol/common/ev_log.h>
+
+#ifdef _WIN32
+  #include <windows.h>
+#else
+  #include <fcntl.h>
+  #include <unistd.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+#endif
+
+struct {
+  const uint8_t *data;
+  uint64_t size;
+  const ShaderArchiveEntry *entries;
+  uint32_t entryCount;
+#ifdef _WIN32
+  HANDLE file;
+  HANDLE mapping;
+#endif
+} ShaderArchiveData;
+
+#define DATA(X) ShaderArchiveData.X
+
+static bool ev_shaderarchive_map(const char *path)
+{
+#ifdef _WIN32
+  DATA(file) = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (DATA(file) == INVALID_HANDLE_VALUE) {
+    return false;
+  }
+
+  LARGE_INTEGER size;
+  GetFileSizeEx(DATA(file), &size);
+  DATA(size) = (uint64_t)size.QuadPart;
+
+  DATA(mapping) = DATA(size) ? CreateFileMappingA(DATA(file), NULL, PAGE_READONLY, 0, 0, NULL) : NULL;
+  DATA(data) = DATA(mapping) ? MapViewOfFile(DATA(mapping), FILE_MAP_READ, 0, 0, 0) : NULL;
+  if (!DATA(data)) {
+    if (DATA(mapping))
+      CloseHandle(DATA(mapping));
+    CloseHandle(DATA(file));
+    return false;
+  }
+#else
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+
+  struct stat st;
+  void *data = MAP_FAILED;
+  if (fstat(fd, &st) == 0 && st.st_size > 0) {
+    data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  }
+  // The mapping keeps the file alive
+  close(fd);
+
+  if (data == MAP_FAILED) {
+    return false;
+  }
+  DATA(data) = data;
+  DATA(size) = st.st_size;
+#endif
+  return true;
+}
+
+static void ev_shaderarchive_unmap()
+{
+#ifdef _WIN32
+  UnmapViewOfFile(DATA(data));
+  CloseHandle(DATA(mapping));
+  CloseHandle(DATA(file));
+#else
+  munmap((void*)DATA(data), DATA(size));
+#endif
+  DATA(data) = NULL;
+  DATA(size) = 0;
+}
+
+// Makes sure no entry points outside of the file
+static bool ev_shaderarchive_validate()
+{
+  if (DATA(size) < sizeof(ShaderArchiveHeader)) {
+    return false;
+  }
+
+  ShaderArchiveHeader header;
+  memcpy(&header, DATA(data), sizeof(ShaderArchiveHeader));
+  if (header.magic != SHADERARCHIVE_MAGIC || header.version != SHADERARCHIVE_VERSION) {
+    return false;
+  }
+
+  if ((DATA(size) - sizeof(ShaderArchiveHeader)) / sizeof(ShaderArchiveEntry) < header.entryCount) {
+    return false;
+  }
+
+  const ShaderArchiveEntry *entries = (const ShaderArchiveEntry*)(DATA(data) + sizeof(ShaderArchiveHeader));
+  for (uint32_t i = 0; i < header.entryCount; i++) {
+    const ShaderArchiveEntry *entry = &entries[i];
+
+    if (memchr(entry->name, '\0', SHADERARCHIVE_MAX_NAME) == NULL
+     || entry->codeOffset % SHADERARCHIVE_ALIGNMENT || entry->codeSize % 4
+     || entry->codeOffset > DATA(size) || entry->codeSize > DATA(size) - entry->codeOffset
+     || entry->bindingOffset > DATA(size)
+     || (DATA(size) - entry->bindingOffset) / sizeof(ShaderArchiveBinding) < entry->bindingCount) {
+      return false;
+    }
+  }
+
+  DATA(entries) = entries;
+  DATA(entryCount) = header.entryCount;
+  return true;
+}
+
+bool ev_shaderarchive_open(const char *path)
+{
+  if (!ev_shaderarchive_map(path)) {
+    return false;
+  }
+
+  if (!ev_shaderarchive_validate()) {
+    ev_log_warn("[ShaderArchive] %s is not a valid shader archive, loading shaders individually", path);
+    ev_shaderarchive_unmap();
+    return false;
+  }
+
+  ev_log_info("[ShaderArchive] Mapped %u shaders from %s", DATA(entryCount), path);
+  return true;
+}
+
+void ev_shaderarchive_close()
+{
+  if (DATA(data)) {
+    ev_shaderarchive_unmap();
+  }
+  DATA(entries) = NULL;
+  DATA(entryCount) = 0;
+}
+
+static int ev_shaderarchive_compareentry(const void *name, const void *entry)
+{
+  return strcmp(name, ((const ShaderArchiveEntry*)entry)->name);
+}
+
+bool ev_shaderarchive_get(const char *name, Shader *shader)
+{
+  if (!DATA(entries)) {
+    return false;
+  }
+
+  const ShaderArchiveEntry *entry = bsearch(name, DATA(entries), DATA(entryCount), sizeof(ShaderArchiveEntry), ev_shaderarchive_compareentry);
+  if (!entry) {
+    return false;
+  }
+
+  *shader = (Shader) {
+    .data = (void*)(DATA(data) + entry->codeOffset),
+    .length = entry->codeSize,
+    .stage = entry->stage,
+    .reflection = entry,
+  };
+  return true;
+}
+
+void ev_shaderarchive_loadreflection(const void *reflection, vec(ReflectedSetLayout) *setLayouts, VkPushConstantRange *pushConstantRange)
+{
+  const ShaderArchiveEntry *entry = reflection;
+  const ShaderArchiveBinding *bindings = (const ShaderArchiveBinding*)(DATA(data) + entry->bindingOffset);
+
+  // The tool writes the bindings grouped by set
+  for (uint32_t i = 0; i < entry->bindingCount; i++) {
+    if (i == 0 || bindings[i].set != bindings[i - 1].set) {
+      vec_push(setLayouts, &(ReflectedSetLayout) {
+        .setNumber = bindings[i].set,
+        .bindings = vec_init(VkDescriptorSetLayoutBinding),
+      });
+    }
+
+    ReflectedSetLayout *layout = &(*setLayouts)[vec_len(*setLayouts) - 1];
+    vec_push(&layout->bindings, &(VkDescriptorSetLayoutBinding) {
+      .binding = bindings[i].binding,
+      .descriptorType = bindings[i].descriptorType,
+      .descriptorCount = bindings[i].descriptorCount,
+      .stageFlags = entry->stage,
+    });
+  }
+
+  if (entry->pushConstantSize > 0) {
+    *pushConstantRange = (VkPushConstantRange) {
+      .offset = entry->pushConstantOffset,
+      .size = entry->pushConstantSize,
+      .stageFlags = VK_SHADER_STAGE_ALL_GRAPHICS,
+    };
+  }
+}
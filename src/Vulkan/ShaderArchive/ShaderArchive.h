@@ -0,0 +1,20 @@
+#pragma once
+
+#include <Vulkan.h>
+#include <ShaderCache/ShaderCache.h>
+
+// Maps the archive at `path` built by `evshaderpack`. Returns false when the
+// file is missing or invalid, shaders are then loaded through the asset
+// manager one by one.
+bool ev_shaderarchive_open(const char *path);
+
+// Unmaps the archive. Shaders handed out by it must not be used afterwards.
+void ev_shaderarchive_close();
+
+// Points `shader` at the SPIR-V of `name` inside the mapping, without
+// copying it. `shader->reflection` is set to the precomputed reflection.
+// Returns false when the archive isn't open or doesn't hold the shader.
+bool ev_shaderarchive_get(const char *name, Shader *shader);
+
+// Fills a cache entry from reflection data returned by `ev_shaderarchive_get`
+void ev_shaderarchive_loadreflection(const void *reflection, vec(ReflectedSetLayout) *setLayouts, VkPushConstantRange *pushConstantRange);
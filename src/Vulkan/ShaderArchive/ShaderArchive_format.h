@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stdint.h>
+
+// NOTE:
+// On-disk layout of a shader archive, shared by the renderer and the
+// `evshaderpack` tool. Everything is little endian and offsets are relative
+// to the start of the file:
+//
+//   ShaderArchiveHeader
+//   ShaderArchiveEntry[entryCount]    sorted by name
+//   ShaderArchiveBinding[...]         reflected bindings of every entry
+//   SPIR-V blobs                      each aligned to SHADERARCHIVE_ALIGNMENT
+//
+// Enum values (stages, descriptor types) are the Vulkan ones.
+
+#define SHADERARCHIVE_MAGIC     0x41535645 // "EVSA"
+#define SHADERARCHIVE_VERSION   1
+#define SHADERARCHIVE_ALIGNMENT 8
+#define SHADERARCHIVE_MAX_NAME  64
+
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t entryCount;
+  uint32_t reserved;
+} ShaderArchiveHeader;
+
+typedef struct {
+  uint32_t set;
+  uint32_t binding;
+  uint32_t descriptorType;
+  uint32_t descriptorCount;
+} ShaderArchiveBinding;
+
+typedef struct {
+  // Null terminated, the asset path of the shader without its scheme
+  char name[SHADERARCHIVE_MAX_NAME];
+  uint32_t stage;
+
+  uint32_t bindingCount;
+  uint64_t bindingOffset;
+
+  uint64_t codeOffset;
+  uint64_t codeSize;
+
+  // `pushConstantSize` is zero when the shader declares no push constants
+  uint32_t pushConstantOffset;
+  uint32_t pushConstantSize;
+} ShaderArchiveEntry;
@@ -0,0 +1,181 @@
+#include <ShaderCache/ShaderCache.h>
+
+#include <Vulkan_utils.h>
+#include <spvref/spirv_reflect.h>
+#include <ContentHash/ContentHash.h>
+#include <ShaderArchive/ShaderArchive.h>
+#include <evol/threads/evolpthreads.h>
+#include <evol/common/ev_log.h>
+
+struct {
+  pthread_mutex_t mutex;
+  // Entries are allocated separately so that returned pointers stay valid
+  vec(CachedShader*) shaders;
+} ShaderCacheData;
+
+#define DATA(X) ShaderCacheData.X
+
+#define SPIRV_HEADER_WORDS 5
+#define SPIRV_OP_DECORATE  71
+#define SPIRV_DECORATION_SPECID 1
+
+// Only looks for SpecId decorations, which is cheap enough to do on the
+// archive's precomputed shaders as well
+static uint64_t ev_shadercache_findspecializationconstants(Shader shader)
+{
+  const uint32_t *words = shader.data;
+  size_t wordCount = shader.length / sizeof(uint32_t);
+  uint64_t constants = 0;
+
+  for (size_t i = SPIRV_HEADER_WORDS; i < wordCount;)
+  {
+    uint32_t instructionWords = words[i] >> 16;
+    uint32_t opcode = words[i] & 0xFFFF;
+    if (instructionWords == 0 || i + instructionWords > wordCount)
+      break;
+
+    if (opcode == SPIRV_OP_DECORATE && instructionWords >= 4 &&
+        words[i + 2] == SPIRV_DECORATION_SPECID && words[i + 3] < 64) {
+      constants |= 1ull << words[i + 3];
+    }
+
+    i += instructionWords;
+  }
+
+  return constants;
+}
+
+static void ev_shadercache_destroysetlayout(ReflectedSetLayout *setLayout)
+{
+  vec_fini(setLayout->bindings);
+}
+
+static void ev_shadercache_destroyshader(CachedShader **shader)
+{
+  ev_vulkan_destroyshadermodule((*shader)->module);
+  vec_fini((*shader)->setLayouts);
+  free(*shader);
+}
+
+static void ev_shadercache_reflect(Shader shader, CachedShader *cached)
+{
+  SpvReflectShaderModule spvmodule;
+  SpvReflectResult result = spvReflectCreateShaderModule(shader.length, shader.data, &spvmodule);
+  assert(result == SPV_REFLECT_RESULT_SUCCESS);
+
+  uint32_t count = 0;
+  result = spvReflectEnumerateDescriptorSets(&spvmodule, &count, NULL);
+  assert(result == SPV_REFLECT_RESULT_SUCCESS);
+
+  vec(SpvReflectDescriptorSet*) sets = vec_init(SpvReflectDescriptorSet*);
+  vec_setlen(&sets, count);
+  result = spvReflectEnumerateDescriptorSets(&spvmodule, &count, sets);
+  assert(result == SPV_REFLECT_RESULT_SUCCESS);
+
+  for (size_t setIndex = 0; setIndex < vec_len(sets); setIndex++)
+  {
+    SpvReflectDescriptorSet* set = sets[setIndex];
+
+    ReflectedSetLayout layout = {
+      .setNumber = set->set,
+      .bindings = vec_init(VkDescriptorSetLayoutBinding),
+    };
+    vec_setlen(&layout.bindings, set->binding_count);
+
+    for (uint32_t i_binding = 0; i_binding < set->binding_count; ++i_binding)
+    {
+      const SpvReflectDescriptorBinding refl_binding = *(set->bindings[i_binding]);
+      VkDescriptorSetLayoutBinding *layout_binding = &layout.bindings[i_binding];
+      layout_binding->binding = refl_binding.binding;
+      layout_binding->descriptorType = (VkDescriptorType)refl_binding.descriptor_type;
+      layout_binding->descriptorCount = 1;
+      layout_binding->pImmutableSamplers = NULL;
+
+      for (uint32_t i_dim = 0; i_dim < refl_binding.array.dims_count; ++i_dim)
+      {
+        layout_binding->descriptorCount *= refl_binding.array.dims[i_dim];
+      }
+      layout_binding->stageFlags = (VkShaderStageFlagBits)spvmodule.shader_stage;
+    }
+
+    vec_push(&cached->setLayouts, &layout);
+  }
+  vec_fini(sets);
+
+  //sprv pushconstant reflection
+  result = spvReflectEnumeratePushConstants(&spvmodule, &count, NULL);
+  assert(result == SPV_REFLECT_RESULT_SUCCESS);
+
+  if (count > 0)
+  {
+    vec(SpvReflectBlockVariable*) pconstants = vec_init(SpvReflectBlockVariable*);
+    vec_setlen(&pconstants, count);
+    result = spvReflectEnumeratePushConstants(&spvmodule, &count, pconstants);
+    assert(result == SPV_REFLECT_RESULT_SUCCESS);
+
+    cached->pushConstantRange = (VkPushConstantRange) {
+      .offset = pconstants[0]->offset,
+      .size = pconstants[0]->size,
+      .stageFlags = VK_SHADER_STAGE_ALL_GRAPHICS,
+    };
+    vec_fini(pconstants);
+  }
+
+  spvReflectDestroyShaderModule(&spvmodule);
+}
+
+void ev_shadercache_init()
+{
+  pthread_mutex_init(&DATA(mutex), NULL);
+  DATA(shaders) = vec_init(CachedShader*, NULL, ev_shadercache_destroyshader);
+}
+
+void ev_shadercache_deinit()
+{
+  vec_fini(DATA(shaders));
+  pthread_mutex_destroy(&DATA(mutex));
+}
+
+const CachedShader *ev_shadercache_get(Shader shader)
+{
+  uint64_t hash = ev_contenthash_compute(shader.data, shader.length, 0);
+
+  // Creation happens under the lock as well, so that concurrent pipeline
+  // builds sharing a shader never create it twice
+  pthread_mutex_lock(&DATA(mutex));
+
+  for (size_t i = 0; i < vec_len(DATA(shaders)); i++) {
+    CachedShader *cached = DATA(shaders)[i];
+    if (cached->hash == hash && cached->length == shader.length) {
+      pthread_mutex_unlock(&DATA(mutex));
+      return cached;
+    }
+  }
+
+  CachedShader *cached = malloc(sizeof(CachedShader));
+  *cached = (CachedShader) {
+    .hash = hash,
+    .length = shader.length,
+    .setLayouts = vec_init(ReflectedSetLayout, NULL, ev_shadercache_destroysetlayout),
+  };
+
+  VkShaderModuleCreateInfo shaderModuleCreateInfo = {
+    .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+    .codeSize = shader.length,
+    .pCode = shader.data,
+  };
+  VK_ASSERT(vkCreateShaderModule(ev_vulkan_getlogicaldevice(), &shaderModuleCreateInfo, NULL, &cached->module));
+
+  if (shader.reflection) {
+    ev_shaderarchive_loadreflection(shader.reflection, &cached->setLayouts, &cached->pushConstantRange);
+  }
+  else {
+    ev_shadercache_reflect(shader, cached);
+  }
+  cached->specializationConstants = ev_shadercache_findspecializationconstants(shader);
+
+  vec_push(&DATA(shaders), &cached);
+
+  pthread_mutex_unlock(&DATA(mutex));
+  return cached;
+}
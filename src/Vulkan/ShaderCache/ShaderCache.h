@@ -0,0 +1,33 @@
+#pragma once
+
+#include <Vulkan.h>
+
+typedef struct {
+  uint32_t setNumber;
+  vec(VkDescriptorSetLayoutBinding) bindings;
+} ReflectedSetLayout;
+
+// A shader module along with everything pipelines need from its reflection.
+// Entries are immutable once returned and live until deinit.
+typedef struct {
+  uint64_t hash;
+  size_t length;
+  VkShaderModule module;
+  vec(ReflectedSetLayout) setLayouts;
+  // `size` is zero when the shader declares no push constants
+  VkPushConstantRange pushConstantRange;
+  // Bit N is set when the shader declares `constant_id = N`, ids past 63
+  // aren't tracked
+  uint64_t specializationConstants;
+} CachedShader;
+
+void ev_shadercache_init();
+
+// Destroys every cached shader module
+void ev_shadercache_deinit();
+
+// Returns the cached module and reflection of `shader`, keyed by the hash of
+// its SPIR-V. Only the first request for a binary creates and reflects it,
+// shaders from the archive come with their reflection precomputed.
+// Safe to call from multiple threads.
+const CachedShader *ev_shadercache_get(Shader shader);
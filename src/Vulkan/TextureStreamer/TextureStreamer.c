@@ -0,0 +1,381 @@
+#include <TextureStreamer/TextureStreamer.h>
+
+#include <vec.h>
+#include <PixelConversion/PixelConversion.h>
+#include <Vulkan_utils.h>
+#include <evol/common/ev_log.h>
+
+// NOTE:
+// The whole mip chain of every texture is kept on the cpu, the gpu image only
+// holds the levels from `residentMip` down to the smallest one. The feedback
+// buffer is cleared at the start of every frame and copied into a per frame
+// readback buffer at its end, so reading it back never stalls the gpu.
+// Textures that stop showing up in the feedback fall back to their mip tail
+// after TEXTURE_EVICTION_FRAMES frames.
+
+#define TEXTURE_EVICTION_FRAMES 120
+
+typedef struct {
+  VkFormat format;
+  uint32_t width;
+  uint32_t height;
+  uint32_t mipCount;
+  uint32_t tailMip;
+
+  uint32_t residentMip;
+  uint32_t requestedMip;
+  uint64_t lastRequestFrame;
+  // Frame from which on recorded frames sample the image of `residentMip`
+  uint64_t residencyFrame;
+
+  unsigned long long mipOffsets[TEXTURE_MAX_MIPS];
+  unsigned long long mipSizes[TEXTURE_MAX_MIPS];
+  uint8_t *pixels;
+} StreamedTexture;
+
+struct {
+  bool enabled;
+  uint32_t textureCapacity;
+  unsigned long long budget;
+  unsigned long long residentSize;
+  uint64_t frame;
+
+  EvBuffer feedbackBuffer;
+  EvBuffer readbackBuffers[SWAPCHAIN_MAX_IMAGES];
+  bool readbackRecorded[SWAPCHAIN_MAX_IMAGES];
+  uint64_t readbackFrame[SWAPCHAIN_MAX_IMAGES];
+
+  vec(StreamedTexture) textures;
+} TextureStreamerData;
+
+#define DATA(X) TextureStreamerData.X
+
+static void ev_texturestreamer_destroytexture(StreamedTexture *texture)
+{
+  free(texture->pixels);
+}
+
+void ev_texturestreamer_init(uint32_t textureCapacity, unsigned long long budget, bool enabled)
+{
+  DATA(enabled) = enabled;
+  DATA(textureCapacity) = textureCapacity;
+  DATA(budget) = budget;
+  DATA(residentSize) = 0;
+  DATA(frame) = 0;
+  DATA(textures) = vec_init(StreamedTexture, NULL, ev_texturestreamer_destroytexture);
+
+  unsigned long long feedbackSize = sizeof(int32_t) * textureCapacity;
+
+  {
+    VmaAllocationCreateInfo allocationCreateInfo = {
+      .usage = VMA_MEMORY_USAGE_GPU_ONLY,
+    };
+
+    VkBufferCreateInfo bufferCreateInfo = { VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+    bufferCreateInfo.size = feedbackSize;
+    bufferCreateInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    ev_vulkan_createbuffer(&bufferCreateInfo, &allocationCreateInfo, &DATA(feedbackBuffer));
+  }
+
+  for (uint32_t i = 0; i < SWAPCHAIN_MAX_IMAGES; i++) {
+    VmaAllocationCreateInfo allocationCreateInfo = {
+      .usage = VMA_MEMORY_USAGE_GPU_TO_CPU,
+      .flags = VMA_ALLOCATION_CREATE_MAPPED_BIT,
+    };
+
+    VkBufferCreateInfo bufferCreateInfo = { VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+    bufferCreateInfo.size = feedbackSize;
+    bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    ev_vulkan_createbuffer(&bufferCreateInfo, &allocationCreateInfo, &DATA(readbackBuffers)[i]);
+    DATA(readbackRecorded)[i] = false;
+  }
+}
+
+void ev_texturestreamer_deinit()
+{
+  for (uint32_t i = 0; i < SWAPCHAIN_MAX_IMAGES; i++) {
+    ev_vulkan_destroybuffer(&DATA(readbackBuffers)[i]);
+  }
+  ev_vulkan_destroybuffer(&DATA(feedbackBuffer));
+
+  vec_fini(DATA(textures));
+}
+
+bool ev_texturestreamer_isenabled()
+{
+  return DATA(enabled);
+}
+
+EvBuffer *ev_texturestreamer_getfeedbackbuffer()
+{
+  return &DATA(feedbackBuffer);
+}
+
+static unsigned long long ev_texturestreamer_residentsize(StreamedTexture *texture, uint32_t firstMip)
+{
+  unsigned long long size = 0;
+  for (uint32_t mip = firstMip; mip < texture->mipCount; mip++) {
+    size += texture->mipSizes[mip];
+  }
+  return size;
+}
+
+void ev_texturestreamer_buildmipchain(VkFormat format, uint32_t width, uint32_t height, uint32_t srcChannelCount, const void *pixels, TextureMipChain *chain)
+{
+  chain->format = format;
+  chain->width = width;
+  chain->height = height;
+  chain->mipCount = ev_vulkan_getmipcount(width, height);
+
+  uint32_t channelCount = ev_vulkan_getformatchannelcount(format);
+  DEBUG_ASSERT(channelCount == ev_pixelconversion_getdstchannelcount(srcChannelCount));
+
+  unsigned long long totalSize = 0;
+  for (uint32_t mip = 0; mip < chain->mipCount; mip++) {
+    chain->mipOffsets[mip] = totalSize;
+    chain->mipSizes[mip] = (unsigned long long)MAX(width >> mip, 1) * MAX(height >> mip, 1) * channelCount;
+    totalSize += chain->mipSizes[mip];
+  }
+
+  chain->pixels = malloc(totalSize);
+  ev_pixelconversion_convert(pixels, srcChannelCount, (uint64_t)width * height, chain->pixels);
+
+  bool srgb = format == VK_FORMAT_R8G8B8A8_SRGB;
+  for (uint32_t mip = 1; mip < chain->mipCount; mip++) {
+    ev_pixelconversion_downsample(
+        chain->pixels + chain->mipOffsets[mip - 1], MAX(width >> (mip - 1), 1), MAX(height >> (mip - 1), 1),
+        channelCount, srgb, chain->pixels + chain->mipOffsets[mip]);
+  }
+}
+
+uint32_t ev_texturestreamer_register(uint32_t textureIndex, TextureMipChain *chain)
+{
+  DEBUG_ASSERT(DATA(enabled));
+  DEBUG_ASSERT(textureIndex == vec_len(DATA(textures)));
+  DEBUG_ASSERT(textureIndex < DATA(textureCapacity));
+
+  StreamedTexture texture = {
+    .format = chain->format,
+    .width = chain->width,
+    .height = chain->height,
+    .mipCount = chain->mipCount,
+    .lastRequestFrame = DATA(frame),
+    .residencyFrame = DATA(frame),
+    .pixels = chain->pixels,
+  };
+  memcpy(texture.mipOffsets, chain->mipOffsets, sizeof(texture.mipOffsets));
+  memcpy(texture.mipSizes, chain->mipSizes, sizeof(texture.mipSizes));
+  chain->pixels = NULL;
+
+  texture.tailMip = texture.mipCount - 1;
+  for (uint32_t mip = 0; mip < texture.tailMip; mip++) {
+    if (MAX(texture.width >> mip, 1) <= TEXTURE_MIPTAIL_SIZE && MAX(texture.height >> mip, 1) <= TEXTURE_MIPTAIL_SIZE) {
+      texture.tailMip = mip;
+      break;
+    }
+  }
+
+  texture.residentMip = texture.tailMip;
+  texture.requestedMip = texture.residentMip;
+  DATA(residentSize) += ev_texturestreamer_residentsize(&texture, texture.residentMip);
+
+  vec_push(&DATA(textures), &texture);
+
+  return texture.residentMip;
+}
+
+void ev_texturestreamer_registerresident(uint32_t textureIndex)
+{
+  DEBUG_ASSERT(textureIndex == vec_len(DATA(textures)));
+
+  // No cpu copy to stream from, the entry only keeps the indices aligned
+  vec_push(&DATA(textures), &(StreamedTexture) {
+    .pixels = NULL,
+  });
+}
+
+void ev_texturestreamer_getlevels(uint32_t textureIndex, uint32_t firstMip, TextureLevels *levels)
+{
+  StreamedTexture *texture = &DATA(textures)[textureIndex];
+  DEBUG_ASSERT(firstMip < texture->mipCount);
+
+  levels->format = texture->format;
+  levels->width = MAX(texture->width >> firstMip, 1);
+  levels->height = MAX(texture->height >> firstMip, 1);
+  levels->mipCount = texture->mipCount - firstMip;
+  for (uint32_t i = 0; i < levels->mipCount; i++) {
+    levels->pixels[i] = texture->pixels + texture->mipOffsets[firstMip + i];
+  }
+}
+
+void ev_texturestreamer_resetfeedback(VkCommandBuffer cmd)
+{
+  // The buffer is shared by every frame slot, the previous frame's readback
+  // copy has to be done with it before it gets cleared
+  VkBufferMemoryBarrier readbackBarrier = {
+    .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+    .srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+    .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+    .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+    .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+    .buffer = DATA(feedbackBuffer).buffer,
+    .offset = 0,
+    .size = VK_WHOLE_SIZE,
+  };
+
+  vkCmdPipelineBarrier(cmd,
+      VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+      0,
+      0, NULL,
+      1, &readbackBarrier,
+      0, NULL);
+
+  vkCmdFillBuffer(cmd, DATA(feedbackBuffer).buffer, 0, VK_WHOLE_SIZE, TEXTURE_FEEDBACK_NONE);
+
+  VkBufferMemoryBarrier barrier = {
+    .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+    .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+    .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+    .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+    .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+    .buffer = DATA(feedbackBuffer).buffer,
+    .offset = 0,
+    .size = VK_WHOLE_SIZE,
+  };
+
+  vkCmdPipelineBarrier(cmd,
+      VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+      0,
+      0, NULL,
+      1, &barrier,
+      0, NULL);
+}
+
+void ev_texturestreamer_readbackfeedback(VkCommandBuffer cmd, uint32_t frameIndex)
+{
+  VkBufferMemoryBarrier barrier = {
+    .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+    .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+    .dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+    .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+    .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+    .buffer = DATA(feedbackBuffer).buffer,
+    .offset = 0,
+    .size = VK_WHOLE_SIZE,
+  };
+
+  vkCmdPipelineBarrier(cmd,
+      VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+      0,
+      0, NULL,
+      1, &barrier,
+      0, NULL);
+
+  VkBufferCopy region = {
+    .srcOffset = 0,
+    .dstOffset = 0,
+    .size = sizeof(int32_t) * DATA(textureCapacity),
+  };
+  vkCmdCopyBuffer(cmd, DATA(feedbackBuffer).buffer, DATA(readbackBuffers)[frameIndex].buffer, 1, &region);
+
+  VkBufferMemoryBarrier hostBarrier = {
+    .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+    .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+    .dstAccessMask = VK_ACCESS_HOST_READ_BIT,
+    .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+    .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+    .buffer = DATA(readbackBuffers)[frameIndex].buffer,
+    .offset = 0,
+    .size = VK_WHOLE_SIZE,
+  };
+
+  vkCmdPipelineBarrier(cmd,
+      VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+      0,
+      0, NULL,
+      1, &hostBarrier,
+      0, NULL);
+
+  DATA(readbackRecorded)[frameIndex] = true;
+  DATA(readbackFrame)[frameIndex] = DATA(frame);
+}
+
+void ev_texturestreamer_update(uint32_t frameIndex, uint32_t maxPromotions, vec(TextureResidencyChange) *changes)
+{
+  DATA(frame)++;
+
+  if (!DATA(enabled) || !DATA(readbackRecorded)[frameIndex]) {
+    return;
+  }
+  DATA(readbackRecorded)[frameIndex] = false;
+
+  EvBuffer *readback = &DATA(readbackBuffers)[frameIndex];
+  vmaInvalidateAllocation(ev_vulkan_getvmaallocator(), readback->allocation, 0, VK_WHOLE_SIZE);
+  const int32_t *feedback = readback->allocationInfo.pMappedData;
+
+  // Evictions go first so that promotions can use the memory they free
+  for (uint32_t i = 0; i < vec_len(DATA(textures)); i++) {
+    StreamedTexture *texture = &DATA(textures)[i];
+    if (!texture->pixels) {
+      continue;
+    }
+
+    // Feedback of frames recorded with an older image is relative to that
+    // image's base level, applying it again would overshoot
+    bool stale = DATA(readbackFrame)[frameIndex] < texture->residencyFrame;
+
+    if (feedback[i] != TEXTURE_FEEDBACK_NONE && stale) {
+      texture->lastRequestFrame = DATA(frame);
+    } else if (feedback[i] != TEXTURE_FEEDBACK_NONE) {
+      int64_t requested = (int64_t)texture->residentMip + feedback[i];
+      requested = MAX(requested, 0);
+      requested = MIN(requested, (int64_t)texture->tailMip);
+
+      texture->requestedMip = (uint32_t)requested;
+      texture->lastRequestFrame = DATA(frame);
+    } else if (DATA(frame) - texture->lastRequestFrame > TEXTURE_EVICTION_FRAMES) {
+      texture->requestedMip = texture->tailMip;
+    }
+
+    if (texture->requestedMip > texture->residentMip) {
+      DATA(residentSize) -= ev_texturestreamer_residentsize(texture, texture->residentMip);
+      DATA(residentSize) += ev_texturestreamer_residentsize(texture, texture->requestedMip);
+      texture->residentMip = texture->requestedMip;
+      texture->residencyFrame = DATA(frame);
+
+      vec_push(changes, &(TextureResidencyChange) {
+        .textureIndex = i,
+        .residentMip = texture->residentMip,
+      });
+    }
+  }
+
+  // Promotions bring in one level at a time
+  uint32_t promotions = 0;
+  for (uint32_t i = 0; i < vec_len(DATA(textures)) && promotions < maxPromotions; i++) {
+    StreamedTexture *texture = &DATA(textures)[i];
+
+    if (texture->requestedMip >= texture->residentMip) {
+      continue;
+    }
+
+    unsigned long long levelSize = texture->mipSizes[texture->residentMip - 1];
+    if (DATA(residentSize) + levelSize > DATA(budget)) {
+      continue;
+    }
+
+    DATA(residentSize) += levelSize;
+    texture->residentMip--;
+    texture->residencyFrame = DATA(frame);
+    promotions++;
+
+    vec_push(changes, &(TextureResidencyChange) {
+      .textureIndex = i,
+      .residentMip = texture->residentMip,
+    });
+  }
+}
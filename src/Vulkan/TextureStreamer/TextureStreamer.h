@@ -0,0 +1,84 @@
+#pragma once
+
+#include <Vulkan.h>
+
+// NOTE:
+// Fragment shaders that sample bindless textures report the mip level they
+// would like to sample through the feedback buffer (resources set, binding 5):
+//
+//   layout(set = 2, binding = 5) buffer TextureFeedback { int requestedMip[]; };
+//   atomicMin(requestedMip[texIndex], int(floor(textureQueryLod(textures[texIndex], uv).y)));
+//
+// The level is relative to the image that was bound when the frame was
+// recorded, so a negative value asks for more detail than what is resident.
+// Feedback of frames recorded before a texture's last residency change is
+// ignored for that texture. Entries that were not written keep
+// TEXTURE_FEEDBACK_NONE.
+
+#define TEXTURE_FEEDBACK_NONE INT32_MAX
+
+// Textures start with every level that fits in this size resident
+#define TEXTURE_MIPTAIL_SIZE 128
+
+typedef struct {
+  uint32_t textureIndex;
+  uint32_t residentMip;
+} TextureResidencyChange;
+
+typedef struct {
+  VkFormat format;
+  uint32_t width;
+  uint32_t height;
+  uint32_t mipCount;
+  void *pixels[TEXTURE_MAX_MIPS];
+} TextureLevels;
+
+typedef struct {
+  VkFormat format;
+  uint32_t width;
+  uint32_t height;
+  uint32_t mipCount;
+  unsigned long long mipOffsets[TEXTURE_MAX_MIPS];
+  unsigned long long mipSizes[TEXTURE_MAX_MIPS];
+  uint8_t *pixels;
+} TextureMipChain;
+
+// `textureCapacity` is the length of the feedback buffer, `budget` the amount
+// of texture memory (in bytes) that streaming is allowed to keep resident.
+void ev_texturestreamer_init(uint32_t textureCapacity, unsigned long long budget, bool enabled);
+
+void ev_texturestreamer_deinit();
+
+// When disabled, textures are registered fully resident and the feedback
+// buffer is only kept around to satisfy the descriptor set layout.
+bool ev_texturestreamer_isenabled();
+
+EvBuffer *ev_texturestreamer_getfeedbackbuffer();
+
+// Converts the decoded pixels to `format` and builds the full mip chain on
+// the cpu. Touches no streamer state, so it is safe to run on the worker
+// threads. `chain->pixels` has to be freed unless the chain gets registered.
+void ev_texturestreamer_buildmipchain(VkFormat format, uint32_t width, uint32_t height, uint32_t srcChannelCount, const void *pixels, TextureMipChain *chain);
+
+// Takes ownership of a chain built by `ev_texturestreamer_buildmipchain` and
+// returns the first mip level that should be resident. Only valid when
+// streaming is enabled.
+uint32_t ev_texturestreamer_register(uint32_t textureIndex, TextureMipChain *chain);
+
+// Registers a texture that stays fully resident, like block compressed ones
+void ev_texturestreamer_registerresident(uint32_t textureIndex);
+
+// Fills `levels` with the mip chain of the texture starting at `firstMip`
+void ev_texturestreamer_getlevels(uint32_t textureIndex, uint32_t firstMip, TextureLevels *levels);
+
+// Recorded before the first pass that writes feedback
+void ev_texturestreamer_resetfeedback(VkCommandBuffer cmd);
+
+// Recorded after the last pass that writes feedback
+void ev_texturestreamer_readbackfeedback(VkCommandBuffer cmd, uint32_t frameIndex);
+
+// Must be called once the fence of `frameIndex` is signaled. Consumes the
+// feedback of that frame and appends the residency changes that need to be
+// applied, promoting at most `maxPromotions` textures. Frames recorded from
+// now on are expected to sample the new images.
+void ev_texturestreamer_update(uint32_t frameIndex, uint32_t maxPromotions, vec(TextureResidencyChange) *changes);
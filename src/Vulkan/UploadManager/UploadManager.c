@@ -0,0 +1,756 @@
+#include <UploadManager/UploadManager.h>
+
+#include <vec.h>
+#include <Vulkan_utils.h>
+#include <evol/common/ev_log.h>
+
+// NOTE:
+// Uploads are staged into a persistently mapped ring buffer and recorded as
+// pending copies. `ev_uploadmanager_flush` submits all of them in a single
+// batch. Every batch owns a fence; once it signals, the ring space used by the
+// batch is reclaimed and its ticket is considered retired.
+// When the device exposes a dedicated transfer family, copies run there and
+// ownership of the written ranges is handed over to the graphics family.
+// Staged regions stay open until a copy commits them. A batch only reclaims
+// the ring up to the oldest open region, and dedicated staging buffers only
+// join a batch once committed, so a flush from another thread never frees
+// memory that is still being written.
+// Mip chains are blitted on the graphics queue, after the ownership transfer
+// when the copies ran on a dedicated transfer family.
+
+#define UPLOAD_BATCH_COUNT 4
+#define UPLOAD_DEFAULT_ALIGNMENT 16
+
+typedef struct {
+  VkBuffer srcBuffer;
+  VkBuffer dstBuffer;
+  VkBufferCopy region;
+} PendingBufferCopy;
+
+typedef struct {
+  VkBuffer srcBuffer;
+  VkImage dstImage;
+  VkImageSubresourceRange range;
+  uint32_t firstCopy;
+  uint32_t copyCount;
+
+  // Levels past the first one are blitted from it once the copy is done
+  bool generateMips;
+  VkExtent2D extent;
+} PendingImageCopy;
+
+typedef struct {
+  VkCommandBuffer transferCmd;
+  VkCommandBuffer acquireCmd;
+  VkSemaphore transferDone;
+  VkFence fence;
+
+  UploadTicket ticket;
+  unsigned long long ringEnd;
+  vec(EvBuffer) dedicatedBuffers;
+} UploadBatch;
+
+struct {
+  pthread_mutex_t mutex;
+
+  EvBuffer ring;
+  unsigned long long ringSize;
+  // Absolute (monotonic) positions, the ring offset is `position % ringSize`
+  unsigned long long ringHead;
+  unsigned long long ringTail;
+
+  vec(PendingBufferCopy) pendingBufferCopies;
+  vec(PendingImageCopy) pendingImageCopies;
+  vec(VkBufferImageCopy) pendingImageCopyRegions;
+  vec(EvBuffer) pendingDedicatedBuffers;
+
+  // Staged but not committed yet. Ring positions are kept in reservation
+  // order, so the first one is the oldest.
+  vec(unsigned long long) openRingRegions;
+  vec(EvBuffer) openDedicatedBuffers;
+
+  vec(VkImageMemoryBarrier) imageBarriers;
+  vec(VkBufferMemoryBarrier) bufferBarriers;
+
+  UploadBatch batches[UPLOAD_BATCH_COUNT];
+  uint32_t oldestBatch;
+  uint32_t inFlightCount;
+
+  UploadTicket submittedTicket;
+  UploadTicket retiredTicket;
+} UploadManagerData;
+
+#define DATA(X) UploadManagerData.X
+
+static void ev_uploadmanager_createstagingbuffer(unsigned long long size, EvBuffer *buffer)
+{
+  VmaAllocationCreateInfo allocationCreateInfo = {
+    .usage = VMA_MEMORY_USAGE_CPU_ONLY,
+    .flags = VMA_ALLOCATION_CREATE_MAPPED_BIT,
+  };
+
+  VkBufferCreateInfo bufferCreateInfo = { VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+  bufferCreateInfo.size = size;
+  bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+  bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+  ev_vulkan_createbuffer(&bufferCreateInfo, &allocationCreateInfo, buffer);
+}
+
+void ev_uploadmanager_init(unsigned long long ringSize)
+{
+  pthread_mutex_init(&DATA(mutex), NULL);
+
+  DATA(ringSize) = ringSize;
+  DATA(ringHead) = 0;
+  DATA(ringTail) = 0;
+  ev_uploadmanager_createstagingbuffer(ringSize, &DATA(ring));
+
+  DATA(pendingBufferCopies) = vec_init(PendingBufferCopy);
+  DATA(pendingImageCopies) = vec_init(PendingImageCopy);
+  DATA(pendingImageCopyRegions) = vec_init(VkBufferImageCopy);
+  DATA(pendingDedicatedBuffers) = vec_init(EvBuffer);
+  DATA(openRingRegions) = vec_init(unsigned long long);
+  DATA(openDedicatedBuffers) = vec_init(EvBuffer);
+
+  DATA(imageBarriers) = vec_init(VkImageMemoryBarrier);
+  DATA(bufferBarriers) = vec_init(VkBufferMemoryBarrier);
+
+  VkSemaphoreCreateInfo semaphoreCreateInfo = {
+    .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+  };
+
+  VkFenceCreateInfo fenceCreateInfo = {
+    .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+  };
+
+  for (size_t i = 0; i < UPLOAD_BATCH_COUNT; i++)
+  {
+    UploadBatch *batch = &DATA(batches)[i];
+
+    ev_vulkan_allocateprimarycommandbuffer(TRANSFER, &batch->transferCmd);
+    ev_vulkan_allocateprimarycommandbuffer(GRAPHICS, &batch->acquireCmd);
+    VK_ASSERT(vkCreateSemaphore(ev_vulkan_getlogicaldevice(), &semaphoreCreateInfo, NULL, &batch->transferDone));
+    VK_ASSERT(vkCreateFence(ev_vulkan_getlogicaldevice(), &fenceCreateInfo, NULL, &batch->fence));
+
+    batch->ticket = INVALID_UPLOAD_TICKET;
+    batch->ringEnd = 0;
+    batch->dedicatedBuffers = vec_init(EvBuffer);
+  }
+
+  DATA(oldestBatch) = 0;
+  DATA(inFlightCount) = 0;
+
+  DATA(submittedTicket) = INVALID_UPLOAD_TICKET;
+  DATA(retiredTicket) = INVALID_UPLOAD_TICKET;
+}
+
+void ev_uploadmanager_deinit()
+{
+  ev_uploadmanager_waitidle();
+
+  for (size_t i = 0; i < UPLOAD_BATCH_COUNT; i++)
+  {
+    UploadBatch *batch = &DATA(batches)[i];
+
+    vkDestroySemaphore(ev_vulkan_getlogicaldevice(), batch->transferDone, NULL);
+    vkDestroyFence(ev_vulkan_getlogicaldevice(), batch->fence, NULL);
+    vec_fini(batch->dedicatedBuffers);
+  }
+
+  vec_fini(DATA(pendingBufferCopies));
+  vec_fini(DATA(pendingImageCopies));
+  vec_fini(DATA(pendingImageCopyRegions));
+  vec_fini(DATA(pendingDedicatedBuffers));
+  vec_fini(DATA(openRingRegions));
+  vec_fini(DATA(openDedicatedBuffers));
+
+  vec_fini(DATA(imageBarriers));
+  vec_fini(DATA(bufferBarriers));
+
+  ev_vulkan_destroybuffer(&DATA(ring));
+
+  pthread_mutex_destroy(&DATA(mutex));
+}
+
+static void ev_uploadmanager_retirebatch(UploadBatch *batch)
+{
+  for (size_t i = 0; i < vec_len(batch->dedicatedBuffers); i++)
+    ev_vulkan_destroybuffer(&batch->dedicatedBuffers[i]);
+  vec_clear(batch->dedicatedBuffers);
+
+  DATA(ringTail) = MAX(DATA(ringTail), batch->ringEnd);
+  DATA(retiredTicket) = batch->ticket;
+
+  DATA(oldestBatch) = (DATA(oldestBatch) + 1) % UPLOAD_BATCH_COUNT;
+  DATA(inFlightCount)--;
+}
+
+// Retires finished batches in submission order. When `waitOldest` is set, the
+// oldest in-flight batch is waited on instead of polled.
+static void ev_uploadmanager_retire(bool waitOldest)
+{
+  while (DATA(inFlightCount) > 0)
+  {
+    UploadBatch *batch = &DATA(batches)[DATA(oldestBatch)];
+
+    if (waitOldest)
+    {
+      VK_ASSERT(vkWaitForFences(ev_vulkan_getlogicaldevice(), 1, &batch->fence, VK_TRUE, ~0ull));
+      waitOldest = false;
+    }
+    else if (vkGetFenceStatus(ev_vulkan_getlogicaldevice(), batch->fence) != VK_SUCCESS)
+    {
+      break;
+    }
+
+    ev_uploadmanager_retirebatch(batch);
+  }
+}
+
+// Fills `imageBarriers` with one barrier for every pending image copy. Images
+// that still need their mip chain generated go to `mipmappedLayout` instead.
+static void ev_uploadmanager_buildimagebarriers(VkImageLayout oldLayout, VkImageLayout newLayout, VkImageLayout mipmappedLayout,
+    VkAccessFlags srcAccess, VkAccessFlags dstAccess, uint32_t srcFamily, uint32_t dstFamily)
+{
+  vec_clear(DATA(imageBarriers));
+  for (size_t i = 0; i < vec_len(DATA(pendingImageCopies)); i++)
+  {
+    PendingImageCopy *copy = &DATA(pendingImageCopies)[i];
+    vec_push(&DATA(imageBarriers), &(VkImageMemoryBarrier) {
+      .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+      .srcAccessMask = srcAccess,
+      .dstAccessMask = dstAccess,
+      .oldLayout = oldLayout,
+      .newLayout = copy->generateMips ? mipmappedLayout : newLayout,
+      .srcQueueFamilyIndex = srcFamily,
+      .dstQueueFamilyIndex = dstFamily,
+      .image = copy->dstImage,
+      .subresourceRange = copy->range,
+    });
+  }
+}
+
+// Fills `bufferBarriers` with one barrier for every pending buffer copy
+static void ev_uploadmanager_buildbufferbarriers(VkAccessFlags srcAccess, VkAccessFlags dstAccess, uint32_t srcFamily, uint32_t dstFamily)
+{
+  vec_clear(DATA(bufferBarriers));
+  for (size_t i = 0; i < vec_len(DATA(pendingBufferCopies)); i++)
+  {
+    PendingBufferCopy *copy = &DATA(pendingBufferCopies)[i];
+    vec_push(&DATA(bufferBarriers), &(VkBufferMemoryBarrier) {
+      .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+      .srcAccessMask = srcAccess,
+      .dstAccessMask = dstAccess,
+      .srcQueueFamilyIndex = srcFamily,
+      .dstQueueFamilyIndex = dstFamily,
+      .buffer = copy->dstBuffer,
+      .offset = copy->region.dstOffset,
+      .size = copy->region.size,
+    });
+  }
+}
+
+static void ev_uploadmanager_recordbarriers(VkCommandBuffer cmd, VkPipelineStageFlags srcStage, VkPipelineStageFlags dstStage)
+{
+  if (vec_len(DATA(bufferBarriers)) == 0 && vec_len(DATA(imageBarriers)) == 0)
+    return;
+
+  vkCmdPipelineBarrier(cmd, srcStage, dstStage, 0,
+      0, NULL,
+      vec_len(DATA(bufferBarriers)), DATA(bufferBarriers),
+      vec_len(DATA(imageBarriers)), DATA(imageBarriers));
+}
+
+// Fills the mip levels of every image that asked for it by blitting each
+// level from the previous one. Expects the whole image in TRANSFER_DST and
+// leaves it in SHADER_READ_ONLY.
+static void ev_uploadmanager_recordmipchains(VkCommandBuffer cmd, VkPipelineStageFlags shaderStages)
+{
+  for (size_t i = 0; i < vec_len(DATA(pendingImageCopies)); i++)
+  {
+    PendingImageCopy *copy = &DATA(pendingImageCopies)[i];
+    if (!copy->generateMips)
+      continue;
+
+    VkImageMemoryBarrier barrier = {
+      .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+      .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+      .dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+      .oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+      .newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+      .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+      .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+      .image = copy->dstImage,
+      .subresourceRange = copy->range,
+    };
+    barrier.subresourceRange.levelCount = 1;
+
+    int32_t width = copy->extent.width;
+    int32_t height = copy->extent.height;
+
+    for (uint32_t level = 1; level < copy->range.levelCount; level++)
+    {
+      barrier.subresourceRange.baseMipLevel = copy->range.baseMipLevel + level - 1;
+      vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+          0, NULL,
+          0, NULL,
+          1, &barrier);
+
+      int32_t nextWidth = width > 1 ? width / 2 : 1;
+      int32_t nextHeight = height > 1 ? height / 2 : 1;
+
+      VkImageBlit blit = {
+        .srcSubresource = {
+          .aspectMask = copy->range.aspectMask,
+          .mipLevel = copy->range.baseMipLevel + level - 1,
+          .baseArrayLayer = copy->range.baseArrayLayer,
+          .layerCount = copy->range.layerCount,
+        },
+        .srcOffsets = { { 0, 0, 0 }, { width, height, 1 } },
+        .dstSubresource = {
+          .aspectMask = copy->range.aspectMask,
+          .mipLevel = copy->range.baseMipLevel + level,
+          .baseArrayLayer = copy->range.baseArrayLayer,
+          .layerCount = copy->range.layerCount,
+        },
+        .dstOffsets = { { 0, 0, 0 }, { nextWidth, nextHeight, 1 } },
+      };
+
+      vkCmdBlitImage(cmd,
+          copy->dstImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+          copy->dstImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+          1, &blit, VK_FILTER_LINEAR);
+
+      width = nextWidth;
+      height = nextHeight;
+    }
+
+    // Every level but the last one was a blit source
+    VkImageMemoryBarrier finalBarriers[2] = { barrier, barrier };
+
+    finalBarriers[0].subresourceRange.baseMipLevel = copy->range.baseMipLevel;
+    finalBarriers[0].subresourceRange.levelCount = copy->range.levelCount - 1;
+    finalBarriers[0].srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    finalBarriers[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    finalBarriers[0].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    finalBarriers[0].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    finalBarriers[1].subresourceRange.baseMipLevel = copy->range.baseMipLevel + copy->range.levelCount - 1;
+    finalBarriers[1].subresourceRange.levelCount = 1;
+    finalBarriers[1].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    finalBarriers[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    finalBarriers[1].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    finalBarriers[1].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, shaderStages, 0,
+        0, NULL,
+        0, NULL,
+        ARRAYSIZE(finalBarriers), finalBarriers);
+  }
+}
+
+static void ev_uploadmanager_submit()
+{
+  if (vec_len(DATA(pendingBufferCopies)) == 0 && vec_len(DATA(pendingImageCopies)) == 0)
+    return;
+
+  if (DATA(inFlightCount) == UPLOAD_BATCH_COUNT)
+    ev_uploadmanager_retire(true);
+
+  UploadBatch *batch = &DATA(batches)[(DATA(oldestBatch) + DATA(inFlightCount)) % UPLOAD_BATCH_COUNT];
+
+  VK_ASSERT(vkResetFences(ev_vulkan_getlogicaldevice(), 1, &batch->fence));
+
+  vmaFlushAllocation(ev_vulkan_getvmaallocator(), DATA(ring).allocation, 0, VK_WHOLE_SIZE);
+  for (size_t i = 0; i < vec_len(DATA(pendingDedicatedBuffers)); i++)
+    vmaFlushAllocation(ev_vulkan_getvmaallocator(), DATA(pendingDedicatedBuffers)[i].allocation, 0, VK_WHOLE_SIZE);
+
+  uint32_t transferFamily = VulkanQueueManager.getFamilyIndex(TRANSFER);
+  uint32_t graphicsFamily = VulkanQueueManager.getFamilyIndex(GRAPHICS);
+  bool sameFamily = transferFamily == graphicsFamily;
+
+  VkQueue graphicsQueue = VulkanQueueManager.getQueue(GRAPHICS);
+  VkQueue transferQueue = sameFamily ? graphicsQueue : VulkanQueueManager.getQueue(TRANSFER);
+
+  VkPipelineStageFlags shaderStages = VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+
+  VkCommandBufferBeginInfo beginInfo = {
+    .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+    .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+  };
+
+  VK_ASSERT(vkBeginCommandBuffer(batch->transferCmd, &beginInfo));
+
+  vec_clear(DATA(bufferBarriers));
+  ev_uploadmanager_buildimagebarriers(
+      VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+      0, VK_ACCESS_TRANSFER_WRITE_BIT,
+      VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED);
+  ev_uploadmanager_recordbarriers(batch->transferCmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+  for (size_t i = 0; i < vec_len(DATA(pendingBufferCopies)); i++)
+  {
+    PendingBufferCopy *copy = &DATA(pendingBufferCopies)[i];
+    vkCmdCopyBuffer(batch->transferCmd, copy->srcBuffer, copy->dstBuffer, 1, &copy->region);
+  }
+
+  for (size_t i = 0; i < vec_len(DATA(pendingImageCopies)); i++)
+  {
+    PendingImageCopy *copy = &DATA(pendingImageCopies)[i];
+    vkCmdCopyBufferToImage(batch->transferCmd, copy->srcBuffer, copy->dstImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        copy->copyCount, &DATA(pendingImageCopyRegions)[copy->firstCopy]);
+  }
+
+  if (sameFamily)
+  {
+    // Everything submitted to this queue afterwards sees the uploaded data
+    ev_uploadmanager_buildbufferbarriers(
+        VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+        VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED);
+    ev_uploadmanager_buildimagebarriers(
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT,
+        VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED);
+    ev_uploadmanager_recordbarriers(batch->transferCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, shaderStages | VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+    ev_uploadmanager_recordmipchains(batch->transferCmd, shaderStages);
+  }
+  else
+  {
+    // Release the written resources to the graphics family. The matching
+    // acquire is recorded in the graphics queue submission below.
+    ev_uploadmanager_buildbufferbarriers(
+        VK_ACCESS_TRANSFER_WRITE_BIT, 0,
+        transferFamily, graphicsFamily);
+    ev_uploadmanager_buildimagebarriers(
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        VK_ACCESS_TRANSFER_WRITE_BIT, 0,
+        transferFamily, graphicsFamily);
+    ev_uploadmanager_recordbarriers(batch->transferCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+  }
+
+  VK_ASSERT(vkEndCommandBuffer(batch->transferCmd));
+
+  VkSubmitInfo transferSubmit = {
+    .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+    .commandBufferCount = 1,
+    .pCommandBuffers = &batch->transferCmd,
+    .signalSemaphoreCount = sameFamily ? 0 : 1,
+    .pSignalSemaphores = &batch->transferDone,
+  };
+
+  VK_ASSERT(vkQueueSubmit(transferQueue, 1, &transferSubmit, sameFamily ? batch->fence : VK_NULL_HANDLE));
+
+  if (!sameFamily)
+  {
+    VK_ASSERT(vkBeginCommandBuffer(batch->acquireCmd, &beginInfo));
+
+    ev_uploadmanager_buildbufferbarriers(
+        0, VK_ACCESS_SHADER_READ_BIT,
+        transferFamily, graphicsFamily);
+    ev_uploadmanager_buildimagebarriers(
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        0, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT,
+        transferFamily, graphicsFamily);
+    ev_uploadmanager_recordbarriers(batch->acquireCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, shaderStages | VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+    ev_uploadmanager_recordmipchains(batch->acquireCmd, shaderStages);
+
+    VK_ASSERT(vkEndCommandBuffer(batch->acquireCmd));
+
+    VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+
+    VkSubmitInfo acquireSubmit = {
+      .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+      .waitSemaphoreCount = 1,
+      .pWaitSemaphores = &batch->transferDone,
+      .pWaitDstStageMask = &waitStage,
+      .commandBufferCount = 1,
+      .pCommandBuffers = &batch->acquireCmd,
+    };
+
+    VK_ASSERT(vkQueueSubmit(graphicsQueue, 1, &acquireSubmit, batch->fence));
+  }
+
+  batch->ticket = ++DATA(submittedTicket);
+  batch->ringEnd = DATA(ringHead);
+  if (vec_len(DATA(openRingRegions)) > 0)
+    batch->ringEnd = MIN(batch->ringEnd, DATA(openRingRegions)[0]);
+
+  for (size_t i = 0; i < vec_len(DATA(pendingDedicatedBuffers)); i++)
+    vec_push(&batch->dedicatedBuffers, &DATA(pendingDedicatedBuffers)[i]);
+
+  vec_clear(DATA(pendingDedicatedBuffers));
+  vec_clear(DATA(pendingBufferCopies));
+  vec_clear(DATA(pendingImageCopies));
+  vec_clear(DATA(pendingImageCopyRegions));
+
+  DATA(inFlightCount)++;
+}
+
+static bool ev_uploadmanager_reserve(unsigned long long size, unsigned long long alignment, unsigned long long *offset, unsigned long long *position)
+{
+  // Nothing is using the ring, restart at its beginning
+  if (DATA(ringTail) == DATA(ringHead))
+  {
+    DATA(ringHead) = ((DATA(ringHead) + DATA(ringSize) - 1) / DATA(ringSize)) * DATA(ringSize);
+    DATA(ringTail) = DATA(ringHead);
+  }
+
+  unsigned long long head = DATA(ringHead);
+  unsigned long long ringOffset = head % DATA(ringSize);
+  unsigned long long alignedOffset = ALIGN_UP(ringOffset, alignment);
+
+  if (alignedOffset + size > DATA(ringSize))
+  {
+    // Doesn't fit before the end of the ring, wrap around
+    head += DATA(ringSize) - ringOffset;
+    alignedOffset = 0;
+  }
+  else
+  {
+    head += alignedOffset - ringOffset;
+  }
+
+  if (head + size - DATA(ringTail) > DATA(ringSize))
+    return false;
+
+  DATA(ringHead) = head + size;
+  *offset = alignedOffset;
+  *position = head;
+  return true;
+}
+
+// Called with the mutex held once a copy out of `region` is recorded
+static void ev_uploadmanager_commit(StagingRegion *region)
+{
+  if (region->ringPosition == UPLOAD_DEDICATED_REGION)
+  {
+    for (size_t i = 0; i < vec_len(DATA(openDedicatedBuffers)); i++)
+    {
+      if (DATA(openDedicatedBuffers)[i].buffer == region->buffer)
+      {
+        vec_push(&DATA(pendingDedicatedBuffers), &DATA(openDedicatedBuffers)[i]);
+        DATA(openDedicatedBuffers)[i] = DATA(openDedicatedBuffers)[vec_len(DATA(openDedicatedBuffers)) - 1];
+        vec_setlen(&DATA(openDedicatedBuffers), vec_len(DATA(openDedicatedBuffers)) - 1);
+        return;
+      }
+    }
+    return;
+  }
+
+  // Keeps the order, the oldest open region bounds what batches reclaim
+  size_t count = vec_len(DATA(openRingRegions));
+  for (size_t i = 0; i < count; i++)
+  {
+    if (DATA(openRingRegions)[i] == region->ringPosition)
+    {
+      memmove(&DATA(openRingRegions)[i], &DATA(openRingRegions)[i + 1], (count - i - 1) * sizeof(unsigned long long));
+      vec_setlen(&DATA(openRingRegions), count - 1);
+      return;
+    }
+  }
+}
+
+void ev_uploadmanager_stage(unsigned long long size, unsigned long long alignment, StagingRegion *region)
+{
+  pthread_mutex_lock(&DATA(mutex));
+
+  if (alignment == 0)
+    alignment = UPLOAD_DEFAULT_ALIGNMENT;
+
+  ev_uploadmanager_retire(false);
+
+  if (size <= DATA(ringSize))
+  {
+    unsigned long long offset, position;
+    bool reserved = ev_uploadmanager_reserve(size, alignment, &offset, &position);
+
+    if (!reserved)
+    {
+      // Ring is full, push what we have and wait for space to free up
+      ev_uploadmanager_submit();
+      while (!reserved && DATA(inFlightCount) > 0)
+      {
+        ev_uploadmanager_retire(true);
+        reserved = ev_uploadmanager_reserve(size, alignment, &offset, &position);
+      }
+    }
+
+    if (reserved)
+    {
+      region->buffer = DATA(ring).buffer;
+      region->offset = offset;
+      region->size = size;
+      region->mappedData = (char*)DATA(ring).allocationInfo.pMappedData + offset;
+      region->ringPosition = position;
+      vec_push(&DATA(openRingRegions), &position);
+
+      pthread_mutex_unlock(&DATA(mutex));
+      return;
+    }
+  }
+
+  // Larger than the whole ring, give it its own staging buffer
+  ev_log_debug("Upload of %llu bytes exceeds the staging ring, using a dedicated staging buffer", size);
+
+  EvBuffer dedicatedBuffer;
+  ev_uploadmanager_createstagingbuffer(size, &dedicatedBuffer);
+  vec_push(&DATA(openDedicatedBuffers), &dedicatedBuffer);
+
+  region->buffer = dedicatedBuffer.buffer;
+  region->offset = 0;
+  region->size = size;
+  region->mappedData = dedicatedBuffer.allocationInfo.pMappedData;
+  region->ringPosition = UPLOAD_DEDICATED_REGION;
+
+  pthread_mutex_unlock(&DATA(mutex));
+}
+
+UploadTicket ev_uploadmanager_copybuffer(StagingRegion *region, EvBuffer *dst, unsigned long long dstOffset)
+{
+  pthread_mutex_lock(&DATA(mutex));
+
+  vec_push(&DATA(pendingBufferCopies), &(PendingBufferCopy) {
+    .srcBuffer = region->buffer,
+    .dstBuffer = dst->buffer,
+    .region = {
+      .srcOffset = region->offset,
+      .dstOffset = dstOffset,
+      .size = region->size,
+    },
+  });
+
+  ev_uploadmanager_commit(region);
+  UploadTicket ticket = DATA(submittedTicket) + 1;
+
+  pthread_mutex_unlock(&DATA(mutex));
+
+  return ticket;
+}
+
+UploadTicket ev_uploadmanager_copyimage(StagingRegion *region, VkImage image, VkImageSubresourceRange range, uint32_t copyCount, VkBufferImageCopy *copies)
+{
+  pthread_mutex_lock(&DATA(mutex));
+
+  vec_push(&DATA(pendingImageCopies), &(PendingImageCopy) {
+    .srcBuffer = region->buffer,
+    .dstImage = image,
+    .range = range,
+    .firstCopy = vec_len(DATA(pendingImageCopyRegions)),
+    .copyCount = copyCount,
+    .generateMips = false,
+  });
+
+  for (uint32_t i = 0; i < copyCount; i++)
+  {
+    VkBufferImageCopy copy = copies[i];
+    copy.bufferOffset += region->offset;
+    vec_push(&DATA(pendingImageCopyRegions), &copy);
+  }
+
+  ev_uploadmanager_commit(region);
+  UploadTicket ticket = DATA(submittedTicket) + 1;
+
+  pthread_mutex_unlock(&DATA(mutex));
+
+  return ticket;
+}
+
+UploadTicket ev_uploadmanager_copyimagegeneratemips(StagingRegion *region, VkImage image, uint32_t width, uint32_t height, uint32_t mipCount)
+{
+  pthread_mutex_lock(&DATA(mutex));
+
+  vec_push(&DATA(pendingImageCopies), &(PendingImageCopy) {
+    .srcBuffer = region->buffer,
+    .dstImage = image,
+    .range = {
+      .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+      .baseMipLevel = 0,
+      .levelCount = mipCount,
+      .baseArrayLayer = 0,
+      .layerCount = 1,
+    },
+    .firstCopy = vec_len(DATA(pendingImageCopyRegions)),
+    .copyCount = 1,
+    .generateMips = mipCount > 1,
+    .extent = { width, height },
+  });
+
+  vec_push(&DATA(pendingImageCopyRegions), &(VkBufferImageCopy) {
+    .bufferOffset = region->offset,
+    .bufferRowLength = 0,
+    .bufferImageHeight = 0,
+
+    .imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+    .imageSubresource.mipLevel = 0,
+    .imageSubresource.baseArrayLayer = 0,
+    .imageSubresource.layerCount = 1,
+
+    .imageOffset = { 0, 0, 0 },
+    .imageExtent = { width, height, 1 },
+  });
+
+  ev_uploadmanager_commit(region);
+  UploadTicket ticket = DATA(submittedTicket) + 1;
+
+  pthread_mutex_unlock(&DATA(mutex));
+
+  return ticket;
+}
+
+UploadTicket ev_uploadmanager_uploadbuffer(const void *data, unsigned long long size, EvBuffer *dst, unsigned long long dstOffset)
+{
+  StagingRegion region;
+  ev_uploadmanager_stage(size, 0, &region);
+  memcpy(region.mappedData, data, size);
+
+  return ev_uploadmanager_copybuffer(&region, dst, dstOffset);
+}
+
+void ev_uploadmanager_flush()
+{
+  pthread_mutex_lock(&DATA(mutex));
+
+  ev_uploadmanager_retire(false);
+  ev_uploadmanager_submit();
+
+  pthread_mutex_unlock(&DATA(mutex));
+}
+
+bool ev_uploadmanager_isretired(UploadTicket ticket)
+{
+  pthread_mutex_lock(&DATA(mutex));
+
+  ev_uploadmanager_retire(false);
+  bool retired = ticket <= DATA(retiredTicket);
+
+  pthread_mutex_unlock(&DATA(mutex));
+
+  return retired;
+}
+
+void ev_uploadmanager_waitticket(UploadTicket ticket)
+{
+  pthread_mutex_lock(&DATA(mutex));
+
+  if (ticket > DATA(submittedTicket))
+    ev_uploadmanager_submit();
+
+  while (DATA(retiredTicket) < ticket && DATA(inFlightCount) > 0)
+    ev_uploadmanager_retire(true);
+
+  pthread_mutex_unlock(&DATA(mutex));
+}
+
+void ev_uploadmanager_waitidle()
+{
+  pthread_mutex_lock(&DATA(mutex));
+
+  ev_uploadmanager_submit();
+  while (DATA(inFlightCount) > 0)
+    ev_uploadmanager_retire(true);
+
+  pthread_mutex_unlock(&DATA(mutex));
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <Vulkan.h>
+
+typedef uint64_t UploadTicket;
+#define INVALID_UPLOAD_TICKET 0ull
+
+typedef struct {
+  void *mappedData;
+  VkBuffer buffer;
+  unsigned long long offset;
+  unsigned long long size;
+  // Absolute position in the staging ring, UPLOAD_DEDICATED_REGION when the
+  // region has its own buffer
+  unsigned long long ringPosition;
+} StagingRegion;
+
+#define UPLOAD_DEDICATED_REGION (~0ull)
+
+void ev_uploadmanager_init(unsigned long long ringSize);
+
+void ev_uploadmanager_deinit();
+
+// Reserves `size` bytes of persistently mapped staging memory. The caller
+// writes into `region->mappedData` and then records a copy out of it, which
+// commits the region. Until then its memory is never reclaimed, even when
+// other threads flush in between.
+void ev_uploadmanager_stage(unsigned long long size, unsigned long long alignment, StagingRegion *region);
+
+UploadTicket ev_uploadmanager_copybuffer(StagingRegion *region, EvBuffer *dst, unsigned long long dstOffset);
+
+// Copies a staged region into `image`. The `bufferOffset` of every copy is
+// relative to the start of the region. The subresources in `range` go from
+// UNDEFINED to SHADER_READ_ONLY_OPTIMAL, so the whole range must be written.
+UploadTicket ev_uploadmanager_copyimage(StagingRegion *region, VkImage image, VkImageSubresourceRange range, uint32_t copyCount, VkBufferImageCopy *copies);
+
+// Copies a staged, tightly packed first level into a color `image` and blits
+// the remaining `mipCount - 1` levels from it. The image format must support
+// linear filtered blits.
+UploadTicket ev_uploadmanager_copyimagegeneratemips(StagingRegion *region, VkImage image, uint32_t width, uint32_t height, uint32_t mipCount);
+
+UploadTicket ev_uploadmanager_uploadbuffer(const void *data, unsigned long long size, EvBuffer *dst, unsigned long long dstOffset);
+
+// Submits every copy recorded since the last flush as a single batch.
+// Called once per frame before any rendering work is submitted.
+void ev_uploadmanager_flush();
+
+bool ev_uploadmanager_isretired(UploadTicket ticket);
+
+void ev_uploadmanager_waitticket(UploadTicket ticket);
+
+void ev_uploadmanager_waitidle();
@@ -3,9 +3,16 @@
 #include <Swapchain.h>
 #include <Vulkan_utils.h>
 #include <DescriptorManager.h>
+#include <UploadManager/UploadManager.h>
+#include <SamplerCache/SamplerCache.h>
+#include <ShaderCache/ShaderCache.h>
+#include <LayoutCache/LayoutCache.h>
+#include <GraphicsLibrary/GraphicsLibrary.h>
+#include <PixelConversion/PixelConversion.h>
 #include <evol/common/ev_log.h>
 
 #define EV_USAGEFLAGS_RESOURCE_BUFFER VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT
+#define EV_USAGEFLAGS_RESOURCE_BUFFER_ADDRESSABLE EV_USAGEFLAGS_RESOURCE_BUFFER | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT
 #define EV_USAGEFLAGS_RESOURCE_IMAGE  VK_IMAGE_USAGE_TRANSFER_DST_BIT    | VK_IMAGE_USAGE_SAMPLED_BIT
 
 struct ev_Vulkan_Data {
@@ -16,12 +23,27 @@ struct ev_Vulkan_Data {
 
   VkSurfaceKHR surface;
 
+  bool requestBufferDeviceAddress;
+  bool bufferDeviceAddress;
+
+  bool graphicsPipelineLibrary;
+  bool descriptorUpdateAfterBind;
+  VkBufferUsageFlags resourceBufferUsage;
+
+  VkPhysicalDeviceFeatures enabledFeatures;
+  float requestedSamplerAnisotropy;
+  float samplerAnisotropy;
+
   VmaPool      buffersPool;
   VmaPool      imagesPool;
   VmaAllocator allocator;
 
   VkCommandPool commandPools[QUEUE_TYPE_COUNT];
 
+  // Reusable command buffer/fence pairs for blocking one-off submissions
+  VkCommandBuffer immediateCommandBuffers[QUEUE_TYPE_COUNT];
+  VkFence immediateFences[QUEUE_TYPE_COUNT];
+
   EvSwapchain swapchain;
 } VulkanData;
 
@@ -41,6 +63,8 @@ int ev_vulkan_init()
   for(int i = 0; i < QUEUE_TYPE_COUNT; ++i)
   {
     VulkanData.commandPools[i] = 0;
+    VulkanData.immediateCommandBuffers[i] = 0;
+    VulkanData.immediateFences[i] = 0;
   }
 
   VK_ASSERT(volkInitialize());
@@ -55,10 +79,19 @@ int ev_vulkan_init()
 
   ev_vulkan_initvma();
 
-  ev_vulkan_createresourcememorypool(EV_USAGEFLAGS_RESOURCE_BUFFER ,128ull * 1024 * 1024, 1, 4, &DATA(buffersPool));
+  DATA(resourceBufferUsage) = DATA(bufferDeviceAddress) ? EV_USAGEFLAGS_RESOURCE_BUFFER_ADDRESSABLE : EV_USAGEFLAGS_RESOURCE_BUFFER;
+
+  ev_vulkan_createresourcememorypool(DATA(resourceBufferUsage)  ,128ull * 1024 * 1024, 1, 4, &DATA(buffersPool));
   ev_vulkan_createresourcememorypool(EV_USAGEFLAGS_RESOURCE_IMAGE  ,512ull * 1024 * 1024, 1, 4, &DATA(imagesPool));
 
   ev_descriptormanager_init();
+
+  ev_samplercache_init();
+  ev_shadercache_init();
+  ev_layoutcache_init();
+  ev_graphicslibrary_init();
+
+  ev_uploadmanager_init(64ull * 1024 * 1024);
   return 0;
 }
 
@@ -68,6 +101,18 @@ int ev_vulkan_deinit()
 
   ev_swapchain_destroy(&DATA(swapchain));
 
+  ev_uploadmanager_deinit();
+
+  // Libraries reference the cached modules and layouts
+  ev_graphicslibrary_deinit();
+  ev_layoutcache_deinit();
+  ev_shadercache_deinit();
+  ev_samplercache_deinit();
+
+  for(int i = 0; i < QUEUE_TYPE_COUNT; ++i)
+    if(VulkanData.immediateFences[i])
+      vkDestroyFence(VulkanData.logicalDevice, VulkanData.immediateFences[i], NULL);
+
   // Destroy any commandpool that was created earlier
   for(int i = 0; i < QUEUE_TYPE_COUNT; ++i)
     if(VulkanData.commandPools[i])
@@ -112,9 +157,15 @@ void ev_vulkan_initvma()
     .vkCreateImage = vkCreateImage,
     .vkDestroyImage = vkDestroyImage,
     .vkCmdCopyBuffer = vkCmdCopyBuffer,
+    .vkGetBufferMemoryRequirements2KHR = vkGetBufferMemoryRequirements2,
+    .vkGetImageMemoryRequirements2KHR = vkGetImageMemoryRequirements2,
+    .vkBindBufferMemory2KHR = vkBindBufferMemory2,
+    .vkBindImageMemory2KHR = vkBindImageMemory2,
+    .vkGetPhysicalDeviceMemoryProperties2KHR = vkGetPhysicalDeviceMemoryProperties2,
   };
 
   VmaAllocatorCreateInfo createInfo = {
+    .flags            = VulkanData.bufferDeviceAddress ? VMA_ALLOCATOR_CREATE_BUFFER_DEVICE_ADDRESS_BIT : 0,
     .physicalDevice   = VulkanData.physicalDevice,
     .device           = VulkanData.logicalDevice,
     .instance         = VulkanData.instance,
@@ -162,6 +213,8 @@ void ev_vulkan_createinstance()
   };
 
   VK_ASSERT(vkCreateInstance(&instanceCreateInfo, NULL, &VulkanData.instance));
+
+  VulkanData.apiVersion = applicationInfo.apiVersion;
 }
 
 void ev_vulkan_detectphysicaldevice()
@@ -185,13 +238,29 @@ void ev_vulkan_detectphysicaldevice()
   }
 }
 
+static bool ev_vulkan_hasdeviceextension(const char *extensionName)
+{
+  uint32_t extensionCount = 0;
+  vkEnumerateDeviceExtensionProperties(VulkanData.physicalDevice, NULL, &extensionCount, NULL);
+
+  VkExtensionProperties extensions[extensionCount];
+  vkEnumerateDeviceExtensionProperties(VulkanData.physicalDevice, NULL, &extensionCount, extensions);
+
+  for(uint32_t i = 0; i < extensionCount; i++)
+    if(!strcmp(extensions[i].extensionName, extensionName))
+      return true;
+
+  return false;
+}
+
 void ev_vulkan_createlogicaldevice()
 {
-  const char *deviceExtensions[] = {
+  const char *deviceExtensions[5] = {
     VK_KHR_SWAPCHAIN_EXTENSION_NAME,
     VK_KHR_MAINTENANCE3_EXTENSION_NAME,
     VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME,
   };
+  uint32_t deviceExtensionCount = 3;
 
   VkDeviceQueueCreateInfo *deviceQueueCreateInfos = NULL;
   unsigned int queueCreateInfoCount = 0;
@@ -205,11 +274,121 @@ void ev_vulkan_createlogicaldevice()
     .descriptorBindingPartiallyBound = VK_TRUE,
   };
 
+  // Lets new bindless resources be written while earlier frames are in flight
+  {
+    VkPhysicalDeviceDescriptorIndexingFeaturesEXT supportedDescriptorIndexingFeatures = {
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT,
+    };
+    VkPhysicalDeviceFeatures2 physicalDeviceFeatures = {
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+      .pNext = &supportedDescriptorIndexingFeatures,
+    };
+    vkGetPhysicalDeviceFeatures2(VulkanData.physicalDevice, &physicalDeviceFeatures);
+
+    VulkanData.descriptorUpdateAfterBind =
+      supportedDescriptorIndexingFeatures.descriptorBindingStorageBufferUpdateAfterBind &&
+      supportedDescriptorIndexingFeatures.descriptorBindingSampledImageUpdateAfterBind &&
+      supportedDescriptorIndexingFeatures.descriptorBindingUpdateUnusedWhilePending;
+
+    physicalDeviceDescriptorIndexingFeatures.descriptorBindingStorageBufferUpdateAfterBind = VulkanData.descriptorUpdateAfterBind;
+    physicalDeviceDescriptorIndexingFeatures.descriptorBindingSampledImageUpdateAfterBind = VulkanData.descriptorUpdateAfterBind;
+    physicalDeviceDescriptorIndexingFeatures.descriptorBindingUpdateUnusedWhilePending = VulkanData.descriptorUpdateAfterBind;
+
+    if(!VulkanData.descriptorUpdateAfterBind)
+      ev_log_info("Descriptor update after bind is not supported by the device, registering resources waits for frames in flight");
+  }
+
+  VkPhysicalDeviceBufferDeviceAddressFeatures physicalDeviceBufferDeviceAddressFeatures = {
+    .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_BUFFER_DEVICE_ADDRESS_FEATURES,
+  };
+
+  VulkanData.bufferDeviceAddress = false;
+  if(VulkanData.requestBufferDeviceAddress)
+  {
+    VkPhysicalDeviceFeatures2 physicalDeviceFeatures = {
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+      .pNext = &physicalDeviceBufferDeviceAddressFeatures,
+    };
+    vkGetPhysicalDeviceFeatures2(VulkanData.physicalDevice, &physicalDeviceFeatures);
+
+    VulkanData.bufferDeviceAddress = physicalDeviceBufferDeviceAddressFeatures.bufferDeviceAddress;
+    if(!VulkanData.bufferDeviceAddress)
+      ev_log_warn("bufferDeviceAddress is not supported by the device, falling back to descriptor indexed buffers");
+
+    // Only enable what we use
+    physicalDeviceBufferDeviceAddressFeatures = (VkPhysicalDeviceBufferDeviceAddressFeatures) {
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_BUFFER_DEVICE_ADDRESS_FEATURES,
+      .bufferDeviceAddress = VulkanData.bufferDeviceAddress,
+    };
+  }
+
+  if(VulkanData.bufferDeviceAddress)
+    physicalDeviceDescriptorIndexingFeatures.pNext = &physicalDeviceBufferDeviceAddressFeatures;
+
+  // Graphics pipeline libraries are used whenever they're available
+  VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT physicalDeviceGraphicsPipelineLibraryFeatures = {
+    .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT,
+  };
+
+  VulkanData.graphicsPipelineLibrary = false;
+  if(ev_vulkan_hasdeviceextension(VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME) &&
+     ev_vulkan_hasdeviceextension(VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME))
+  {
+    VkPhysicalDeviceFeatures2 physicalDeviceFeatures = {
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+      .pNext = &physicalDeviceGraphicsPipelineLibraryFeatures,
+    };
+    vkGetPhysicalDeviceFeatures2(VulkanData.physicalDevice, &physicalDeviceFeatures);
+
+    VulkanData.graphicsPipelineLibrary = physicalDeviceGraphicsPipelineLibraryFeatures.graphicsPipelineLibrary;
+  }
+
+  if(VulkanData.graphicsPipelineLibrary)
+  {
+    deviceExtensions[deviceExtensionCount++] = VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME;
+    deviceExtensions[deviceExtensionCount++] = VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME;
+
+    physicalDeviceGraphicsPipelineLibraryFeatures = (VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT) {
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT,
+      .pNext = physicalDeviceDescriptorIndexingFeatures.pNext,
+      .graphicsPipelineLibrary = VK_TRUE,
+    };
+    physicalDeviceDescriptorIndexingFeatures.pNext = &physicalDeviceGraphicsPipelineLibraryFeatures;
+  }
+  else
+  {
+    ev_log_info("VK_EXT_graphics_pipeline_library is not supported by the device, pipelines are compiled monolithically");
+  }
+
+  VkPhysicalDeviceFeatures supportedFeatures;
+  vkGetPhysicalDeviceFeatures(VulkanData.physicalDevice, &supportedFeatures);
+
+  // Texture feedback is written from fragment shaders
+  VulkanData.enabledFeatures = (VkPhysicalDeviceFeatures) {
+    .fragmentStoresAndAtomics = supportedFeatures.fragmentStoresAndAtomics,
+    .samplerAnisotropy = supportedFeatures.samplerAnisotropy && VulkanData.requestedSamplerAnisotropy > 1.0f,
+    .textureCompressionBC = supportedFeatures.textureCompressionBC,
+    .textureCompressionASTC_LDR = supportedFeatures.textureCompressionASTC_LDR,
+  };
+
+  VulkanData.samplerAnisotropy = 0.0f;
+  if(VulkanData.enabledFeatures.samplerAnisotropy)
+  {
+    VkPhysicalDeviceProperties deviceProperties;
+    vkGetPhysicalDeviceProperties(VulkanData.physicalDevice, &deviceProperties);
+    VulkanData.samplerAnisotropy = MIN(VulkanData.requestedSamplerAnisotropy, deviceProperties.limits.maxSamplerAnisotropy);
+  }
+  else if(VulkanData.requestedSamplerAnisotropy > 1.0f)
+  {
+    ev_log_warn("samplerAnisotropy is not supported by the device, texture filtering stays isotropic");
+  }
+
   VkDeviceCreateInfo deviceCreateInfo =
   {
     .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
     .pNext = &physicalDeviceDescriptorIndexingFeatures,
-    .enabledExtensionCount = ARRAYSIZE(deviceExtensions),
+    .pEnabledFeatures = &VulkanData.enabledFeatures,
+    .enabledExtensionCount = deviceExtensionCount,
     .ppEnabledExtensionNames = deviceExtensions,
     .queueCreateInfoCount = queueCreateInfoCount,
     .pQueueCreateInfos = deviceQueueCreateInfos,
@@ -472,6 +651,48 @@ VkCommandPool ev_vulkan_getcommandpool(QueueType type)
   return VulkanData.commandPools[type];
 }
 
+VkCommandBuffer ev_vulkan_beginimmediatesubmit(QueueType type)
+{
+  if(!VulkanData.immediateCommandBuffers[type])
+  {
+    ev_vulkan_allocateprimarycommandbuffer(type, &VulkanData.immediateCommandBuffers[type]);
+
+    VkFenceCreateInfo fenceCreateInfo = {
+      .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+    };
+    VK_ASSERT(vkCreateFence(VulkanData.logicalDevice, &fenceCreateInfo, NULL, &VulkanData.immediateFences[type]));
+  }
+
+  VkCommandBuffer cmd = VulkanData.immediateCommandBuffers[type];
+  VK_ASSERT(vkResetCommandBuffer(cmd, 0));
+
+  VkCommandBufferBeginInfo beginInfo = {
+    .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+    .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+  };
+  VK_ASSERT(vkBeginCommandBuffer(cmd, &beginInfo));
+
+  return cmd;
+}
+
+void ev_vulkan_endimmediatesubmit(QueueType type)
+{
+  VkCommandBuffer cmd = VulkanData.immediateCommandBuffers[type];
+  VkFence fence = VulkanData.immediateFences[type];
+
+  VK_ASSERT(vkEndCommandBuffer(cmd));
+
+  VkSubmitInfo submitInfo = {
+    .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+    .commandBufferCount = 1,
+    .pCommandBuffers = &cmd,
+  };
+  VK_ASSERT(vkQueueSubmit(VulkanQueueManager.getQueue(type), 1, &submitInfo, fence));
+
+  VK_ASSERT(vkWaitForFences(VulkanData.logicalDevice, 1, &fence, VK_TRUE, ~0ull));
+  VK_ASSERT(vkResetFences(VulkanData.logicalDevice, 1, &fence));
+}
+
 void ev_vulkan_createdescriptorpool(VkDescriptorPoolCreateInfo *info, VkDescriptorPool *pool)
 {
   VK_ASSERT(vkCreateDescriptorPool(DATA(logicalDevice), info, NULL, pool));
@@ -596,40 +817,15 @@ void ev_vulkan_freeubo(UBO *ubo)
 
 void ev_vulkan_copybuffer(unsigned long long size, EvBuffer *src, EvBuffer *dst)
 {
-  VkCommandBuffer tempCommandBuffer;
-  ev_vulkan_allocateprimarycommandbuffer(TRANSFER, &tempCommandBuffer);
-
-  VkCommandBufferBeginInfo tempCommandBufferBeginInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
-  tempCommandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-
-  vkBeginCommandBuffer(tempCommandBuffer, &tempCommandBufferBeginInfo);
+  VkCommandBuffer cmd = ev_vulkan_beginimmediatesubmit(GRAPHICS);
 
   VkBufferCopy copyRegion;
   copyRegion.srcOffset = 0;
   copyRegion.dstOffset = 0;
   copyRegion.size = size;
-  vkCmdCopyBuffer(tempCommandBuffer, src->buffer, dst->buffer, 1, &copyRegion);
-
-  vkEndCommandBuffer(tempCommandBuffer);
-
-  VkPipelineStageFlags stageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
-
-  VkSubmitInfo submitInfo         = {VK_STRUCTURE_TYPE_SUBMIT_INFO};
-  submitInfo.pWaitDstStageMask    = &stageMask;
-  submitInfo.commandBufferCount   = 1;
-  submitInfo.pCommandBuffers      = &tempCommandBuffer;
-  submitInfo.waitSemaphoreCount   = 0;
-  submitInfo.pWaitSemaphores      = NULL;
-  submitInfo.signalSemaphoreCount = 0;
-  submitInfo.pSignalSemaphores    = NULL;
-
-  VkQueue transferQueue = VulkanQueueManager.getQueue(TRANSFER);
-  VK_ASSERT(vkQueueSubmit(transferQueue, 1, &submitInfo, VK_NULL_HANDLE));
+  vkCmdCopyBuffer(cmd, src->buffer, dst->buffer, 1, &copyRegion);
 
-  //TODO Change this to take advantage of fences
-  vkQueueWaitIdle(transferQueue);
-
-  //vkFreeCommandBuffers(ev_vulkan_getlogicaldevice(), tempCommandBuffer, 1, &tempCommandBuffer);
+  ev_vulkan_endimmediatesubmit(GRAPHICS);
 }
 
 void ev_vulkan_updatestagingbuffer(EvBuffer *buffer, unsigned long long bufferSize, const void *data)
@@ -680,17 +876,56 @@ void ev_vulkan_createresourcememorypool(VkBufferUsageFlagBits memoryFlags ,unsig
   ev_vulkan_allocatememorypool(&poolCreateInfo, pool);
 }
 
+void ev_vulkan_allocateresourcebuffer(unsigned long long size, EvBuffer *buffer)
+{
+  ev_vulkan_allocatebufferinpool(DATA(buffersPool), size, DATA(resourceBufferUsage), buffer);
+}
+
+void ev_vulkan_requestbufferdeviceaddress(bool enable)
+{
+  DATA(requestBufferDeviceAddress) = enable;
+}
+
+bool ev_vulkan_hasbufferdeviceaddress()
+{
+  return DATA(bufferDeviceAddress);
+}
+
+void ev_vulkan_requestsampleranisotropy(float maxAnisotropy)
+{
+  DATA(requestedSamplerAnisotropy) = maxAnisotropy;
+}
+
+const VkPhysicalDeviceFeatures *ev_vulkan_getenabledfeatures()
+{
+  return &VulkanData.enabledFeatures;
+}
+
+bool ev_vulkan_hasgraphicspipelinelibrary()
+{
+  return DATA(graphicsPipelineLibrary);
+}
+
+bool ev_vulkan_hasdescriptorupdateafterbind()
+{
+  return DATA(descriptorUpdateAfterBind);
+}
+
+VkDeviceAddress ev_vulkan_getbufferaddress(EvBuffer *buffer)
+{
+  VkBufferDeviceAddressInfo addressInfo = {
+    .sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO,
+    .buffer = buffer->buffer,
+  };
+  return vkGetBufferDeviceAddress(DATA(logicalDevice), &addressInfo);
+}
+
 EvBuffer ev_vulkan_registerbuffer(void *data, unsigned long long size)
 {
   EvBuffer newBuffer;
-  ev_vulkan_allocatebufferinpool(DATA(buffersPool), size, EV_USAGEFLAGS_RESOURCE_BUFFER, &newBuffer);
-
-  EvBuffer newStagingBuffer;
-  ev_vulkan_allocatestagingbuffer(size, &newStagingBuffer);
-  ev_vulkan_updatestagingbuffer(&newStagingBuffer, size, data);
-  ev_vulkan_copybuffer(size, &newStagingBuffer, &newBuffer);
+  ev_vulkan_allocateresourcebuffer(size, &newBuffer);
 
-  ev_vulkan_destroybuffer(&newStagingBuffer);
+  ev_uploadmanager_uploadbuffer(data, size, &newBuffer, 0);
 
   return newBuffer;
 }
@@ -814,12 +1049,7 @@ void ev_vulkan_allocateimageinpool(VmaPool pool, uint32_t width, uint32_t height
 
 void ev_vulkan_transitionimagelayout(EvImage image, VkFormat format, uint32_t layerCount, VkImageLayout oldLayout, VkImageLayout newLayout)
 {
-  VkCommandBuffer tempCommandBuffer;
-  ev_vulkan_allocateprimarycommandbuffer(TRANSFER, &tempCommandBuffer);
-  VkCommandBufferBeginInfo tempCommandBufferBeginInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
-  tempCommandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-  vkBeginCommandBuffer(tempCommandBuffer, &tempCommandBufferBeginInfo);
-
+  VkCommandBuffer cmd = ev_vulkan_beginimmediatesubmit(GRAPHICS);
 
   VkImageMemoryBarrier barrier = {
     .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
@@ -854,7 +1084,7 @@ void ev_vulkan_transitionimagelayout(EvImage image, VkFormat format, uint32_t la
   }
 
   vkCmdPipelineBarrier(
-      tempCommandBuffer,
+      cmd,
       sourceStage, destinationStage,
       0,
       0, NULL,
@@ -862,36 +1092,12 @@ void ev_vulkan_transitionimagelayout(EvImage image, VkFormat format, uint32_t la
       1, &barrier
   );
 
-
-  vkEndCommandBuffer(tempCommandBuffer);
-
-  VkPipelineStageFlags stageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
-
-  VkSubmitInfo submitInfo         = {VK_STRUCTURE_TYPE_SUBMIT_INFO};
-  submitInfo.pWaitDstStageMask    = &stageMask;
-  submitInfo.commandBufferCount   = 1;
-  submitInfo.pCommandBuffers      = &tempCommandBuffer;
-  submitInfo.waitSemaphoreCount   = 0;
-  submitInfo.pWaitSemaphores      = NULL;
-  submitInfo.signalSemaphoreCount = 0;
-  submitInfo.pSignalSemaphores    = NULL;
-
-  VkQueue transferQueue = VulkanQueueManager.getQueue(TRANSFER);
-  VK_ASSERT(vkQueueSubmit(transferQueue, 1, &submitInfo, VK_NULL_HANDLE));
-
-  //TODO Change this to take advantage of fences
-  vkQueueWaitIdle(transferQueue);
-
-  //vkFreeCommandBuffers(VulkanData.logicalDevice, DATA(transferCommandPool), 1, &tempCommandBuffer);
+  ev_vulkan_endimmediatesubmit(GRAPHICS);
 }
 
 void ev_vulkan_copybuffertoimage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, uint32_t layerCount)
 {
-  VkCommandBuffer tempCommandBuffer;
-  ev_vulkan_allocateprimarycommandbuffer(TRANSFER, &tempCommandBuffer);
-  VkCommandBufferBeginInfo tempCommandBufferBeginInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
-  tempCommandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-  vkBeginCommandBuffer(tempCommandBuffer, &tempCommandBufferBeginInfo);
+  VkCommandBuffer cmd = ev_vulkan_beginimmediatesubmit(GRAPHICS);
 
   VkBufferImageCopy region = {
     .bufferOffset = 0,
@@ -913,7 +1119,7 @@ void ev_vulkan_copybuffertoimage(VkBuffer buffer, VkImage image, uint32_t width,
   region.imageExtent.width = width;
 
   vkCmdCopyBufferToImage(
-      tempCommandBuffer,
+      cmd,
       buffer,
       image,
       VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
@@ -921,49 +1127,122 @@ void ev_vulkan_copybuffertoimage(VkBuffer buffer, VkImage image, uint32_t width,
       &region
   );
 
+  ev_vulkan_endimmediatesubmit(GRAPHICS);
+}
+
+// Queues the copy of a staged, tightly packed single mip image. The layout
+// transitions are batched with every other upload of the same flush.
+static void ev_vulkan_uploadimage(StagingRegion *stagingRegion, VkImage image, uint32_t width, uint32_t height, uint32_t layerCount)
+{
+  VkImageSubresourceRange range = {
+    .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+    .baseMipLevel = 0,
+    .levelCount = 1,
+    .baseArrayLayer = 0,
+    .layerCount = layerCount,
+  };
 
-  vkEndCommandBuffer(tempCommandBuffer);
+  VkBufferImageCopy region = {
+    .bufferOffset = 0,
+    .bufferRowLength = 0,
+    .bufferImageHeight = 0,
 
-  VkPipelineStageFlags stageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    .imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+    .imageSubresource.mipLevel = 0,
+    .imageSubresource.baseArrayLayer = 0,
+    .imageSubresource.layerCount = layerCount,
 
-  VkSubmitInfo submitInfo         = {VK_STRUCTURE_TYPE_SUBMIT_INFO};
-  submitInfo.pWaitDstStageMask    = &stageMask;
-  submitInfo.commandBufferCount   = 1;
-  submitInfo.pCommandBuffers      = &tempCommandBuffer;
-  submitInfo.waitSemaphoreCount   = 0;
-  submitInfo.pWaitSemaphores      = NULL;
-  submitInfo.signalSemaphoreCount = 0;
-  submitInfo.pSignalSemaphores    = NULL;
+    .imageOffset = { 0, 0, 0 },
+    .imageExtent = { width, height, 1 },
+  };
 
-  VkQueue transferQueue = VulkanQueueManager.getQueue(TRANSFER);
-  VK_ASSERT(vkQueueSubmit(transferQueue, 1, &submitInfo, VK_NULL_HANDLE));
+  ev_uploadmanager_copyimage(stagingRegion, image, range, 1, &region);
+}
 
-  //TODO Change this to take advantage of fences
-  vkQueueWaitIdle(transferQueue);
+uint32_t ev_vulkan_getformatchannelcount(VkFormat format)
+{
+  switch (format) {
+    case VK_FORMAT_R8_UNORM:
+      return 1;
+    case VK_FORMAT_R8G8_UNORM:
+      return 2;
+    case VK_FORMAT_R8G8B8A8_UNORM:
+    case VK_FORMAT_R8G8B8A8_SRGB:
+      return 4;
+    default:
+      return 0;
+  }
+}
 
-  //vkFreeCommandBuffers(Vulkan.getDevice(), DATA(transferCommandPool), 1, &tempCommandBuffer);
+uint32_t ev_vulkan_getmipcount(uint32_t width, uint32_t height)
+{
+  uint32_t mipCount = 1;
+  while ((width > 1 || height > 1) && mipCount < TEXTURE_MAX_MIPS) {
+    width = MAX(width / 2, 1);
+    height = MAX(height / 2, 1);
+    mipCount++;
+  }
+  return mipCount;
 }
 
-EvTexture ev_vulkan_registerTexture(VkFormat format, uint32_t width, uint32_t height, void* pixels)
+static bool ev_vulkan_canblit(VkFormat format)
 {
-  uint32_t size = width * height * 4;
+  VkFormatFeatureFlags required = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
 
-  EvImage newimage;
-  ev_vulkan_allocateimageinpool(DATA(imagesPool), width, height , EV_USAGEFLAGS_RESOURCE_IMAGE, &newimage);
-  EvBuffer imageStagingBuffer;
-  ev_vulkan_allocatestagingbuffer(size, &imageStagingBuffer);
-  ev_vulkan_updatestagingbuffer(&imageStagingBuffer, size, pixels);
+  VkFormatProperties formatProperties;
+  vkGetPhysicalDeviceFormatProperties(VulkanData.physicalDevice, format, &formatProperties);
+  return (formatProperties.optimalTilingFeatures & required) == required;
+}
 
-  ev_vulkan_transitionimagelayout(newimage, format, 1, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-  ev_vulkan_copybuffertoimage(imageStagingBuffer.buffer, newimage.image, width, height, 1);
-  ev_vulkan_transitionimagelayout(newimage, format, 1, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+static void ev_vulkan_createtextureimage(VkFormat format, uint32_t width, uint32_t height, uint32_t mipCount, EvImage *image)
+{
+  VkImageCreateInfo imageCreateInfo = {
+    .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+    .imageType = VK_IMAGE_TYPE_2D,
+    .extent.width = width,
+    .extent.height = height,
+    .extent.depth = 1,
+    .mipLevels = mipCount,
+    .arrayLayers = 1,
+    .format = format,
+    .tiling = VK_IMAGE_TILING_OPTIMAL,
+    .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+    .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+    // Blits read back from the image while building its mip chain
+    .usage = EV_USAGEFLAGS_RESOURCE_IMAGE | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+    .samples = VK_SAMPLE_COUNT_1_BIT,
+  };
+
+  VmaAllocationCreateInfo allocationCreateInfo = {
+    .pool = DATA(imagesPool),
+  };
 
-  ev_vulkan_destroybuffer(&imageStagingBuffer);
+  ev_vulkan_createimage(&imageCreateInfo, &allocationCreateInfo, image);
+}
 
+// Wraps an uploaded image in a view over all of its levels and a cached sampler
+static EvTexture ev_vulkan_createtexture(VkFormat format, uint32_t mipCount, EvImage image)
+{
   VkImageView imageView;
-  ev_vulkan_createimageview(format, &newimage.image, &imageView);
+  {
+    VkImageViewCreateInfo imageViewCreateInfo = {
+      .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+      .image = image.image,
+      .viewType = VK_IMAGE_VIEW_TYPE_2D,
+      .format = format,
+      .components = {0, 0, 0, 0},
+      .subresourceRange = {
+          .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+          .baseMipLevel = 0,
+          .levelCount = mipCount,
+          .baseArrayLayer = 0,
+          .layerCount = 1,
+        },
+    };
+
+    vkCreateImageView(VulkanData.logicalDevice, &imageViewCreateInfo, NULL, &imageView);
+  }
 
-  VkSampler sampler;
   VkSamplerCreateInfo samplerInfo =
   {
       .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
@@ -972,8 +1251,8 @@ EvTexture ev_vulkan_registerTexture(VkFormat format, uint32_t width, uint32_t he
       .addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT,
       .addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT,
       .addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT,
-      .anisotropyEnable = VK_FALSE,
-      .maxAnisotropy = 1.0f,
+      .anisotropyEnable = DATA(samplerAnisotropy) > 1.0f,
+      .maxAnisotropy = MAX(DATA(samplerAnisotropy), 1.0f),
       .borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK,
       .unnormalizedCoordinates = VK_FALSE,
       .compareEnable = VK_FALSE,
@@ -981,18 +1260,132 @@ EvTexture ev_vulkan_registerTexture(VkFormat format, uint32_t width, uint32_t he
       .mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR,
       .mipLodBias = 0.0f,
       .minLod = 0.0f,
-      .maxLod = 0.0f,
+      .maxLod = VK_LOD_CLAMP_NONE,
   };
-  vkCreateSampler(VulkanData.logicalDevice, &samplerInfo, NULL, &sampler);
 
   EvTexture evtexture = {
-      .image = newimage,
+      .image = image,
       .imageView = imageView,
-      .sampler = sampler
+      .sampler = ev_samplercache_get(&samplerInfo)
   };
   return evtexture;
 }
 
+EvTexture ev_vulkan_registerTexture(VkFormat format, uint32_t width, uint32_t height, uint32_t srcChannelCount, const void* pixels)
+{
+  uint32_t channelCount = ev_vulkan_getformatchannelcount(format);
+  DEBUG_ASSERT(channelCount == ev_pixelconversion_getdstchannelcount(srcChannelCount));
+
+  uint32_t mipCount = ev_vulkan_getmipcount(width, height);
+  unsigned long long size = (unsigned long long)width * height * channelCount;
+
+  if (!ev_vulkan_canblit(format))
+  {
+    // Build the chain on the cpu instead
+    bool srgb = format == VK_FORMAT_R8G8B8A8_SRGB;
+    void *mipPixels[TEXTURE_MAX_MIPS];
+    mipPixels[0] = malloc(size);
+    ev_pixelconversion_convert(pixels, srcChannelCount, (uint64_t)width * height, mipPixels[0]);
+
+    for (uint32_t mip = 1; mip < mipCount; mip++) {
+      uint32_t srcWidth = MAX(width >> (mip - 1), 1);
+      uint32_t srcHeight = MAX(height >> (mip - 1), 1);
+      mipPixels[mip] = malloc((unsigned long long)MAX(srcWidth / 2, 1) * MAX(srcHeight / 2, 1) * channelCount);
+      ev_pixelconversion_downsample(mipPixels[mip - 1], srcWidth, srcHeight, channelCount, srgb, mipPixels[mip]);
+    }
+
+    EvTexture texture = ev_vulkan_registerTextureMips(format, width, height, mipCount, mipPixels);
+
+    for (uint32_t mip = 0; mip < mipCount; mip++) {
+      free(mipPixels[mip]);
+    }
+    return texture;
+  }
+
+  EvImage newimage;
+  ev_vulkan_createtextureimage(format, width, height, mipCount, &newimage);
+
+  // Decoded pixels are converted straight into the staging memory
+  StagingRegion stagingRegion;
+  ev_uploadmanager_stage(size, 0, &stagingRegion);
+  ev_pixelconversion_convert(pixels, srcChannelCount, (uint64_t)width * height, stagingRegion.mappedData);
+
+  ev_uploadmanager_copyimagegeneratemips(&stagingRegion, newimage.image, width, height, mipCount);
+
+  return ev_vulkan_createtexture(format, mipCount, newimage);
+}
+
+EvTexture ev_vulkan_registerTextureMips(VkFormat format, uint32_t width, uint32_t height, uint32_t mipCount, void** mipPixels)
+{
+  unsigned long long mipSizes[TEXTURE_MAX_MIPS];
+  uint32_t channelCount = ev_vulkan_getformatchannelcount(format);
+  DEBUG_ASSERT(mipCount <= ARRAYSIZE(mipSizes));
+
+  for (uint32_t mip = 0; mip < mipCount; mip++) {
+    mipSizes[mip] = (unsigned long long)MAX(width >> mip, 1) * MAX(height >> mip, 1) * channelCount;
+  }
+
+  return ev_vulkan_registerTextureLevels(format, width, height, mipCount, (const void**)mipPixels, mipSizes);
+}
+
+EvTexture ev_vulkan_registerTextureLevels(VkFormat format, uint32_t width, uint32_t height, uint32_t mipCount, const void** levelData, const unsigned long long *levelSizes)
+{
+  unsigned long long mipOffsets[TEXTURE_MAX_MIPS];
+  unsigned long long totalSize = 0;
+  DEBUG_ASSERT(mipCount <= ARRAYSIZE(mipOffsets));
+
+  // Copies out of compressed formats have to start on a block boundary
+  for (uint32_t mip = 0; mip < mipCount; mip++) {
+    mipOffsets[mip] = totalSize;
+    totalSize = ALIGN_UP(totalSize + levelSizes[mip], 16);
+  }
+
+  EvImage newimage;
+  ev_vulkan_createtextureimage(format, width, height, mipCount, &newimage);
+
+  StagingRegion stagingRegion;
+  ev_uploadmanager_stage(totalSize, 16, &stagingRegion);
+
+  VkBufferImageCopy copies[TEXTURE_MAX_MIPS];
+  for (uint32_t mip = 0; mip < mipCount; mip++) {
+    memcpy((char*)stagingRegion.mappedData + mipOffsets[mip], levelData[mip], levelSizes[mip]);
+
+    copies[mip] = (VkBufferImageCopy) {
+      .bufferOffset = mipOffsets[mip],
+      .bufferRowLength = 0,
+      .bufferImageHeight = 0,
+
+      .imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+      .imageSubresource.mipLevel = mip,
+      .imageSubresource.baseArrayLayer = 0,
+      .imageSubresource.layerCount = 1,
+
+      .imageOffset = { 0, 0, 0 },
+      .imageExtent = { MAX(width >> mip, 1), MAX(height >> mip, 1), 1 },
+    };
+  }
+
+  VkImageSubresourceRange range = {
+    .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+    .baseMipLevel = 0,
+    .levelCount = mipCount,
+    .baseArrayLayer = 0,
+    .layerCount = 1,
+  };
+  ev_uploadmanager_copyimage(&stagingRegion, newimage.image, range, mipCount, copies);
+
+  return ev_vulkan_createtexture(format, mipCount, newimage);
+}
+
+bool ev_vulkan_issampledformatsupported(VkFormat format)
+{
+  VkFormatFeatureFlags required = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT | VK_FORMAT_FEATURE_TRANSFER_DST_BIT;
+
+  VkFormatProperties formatProperties;
+  vkGetPhysicalDeviceFormatProperties(VulkanData.physicalDevice, format, &formatProperties);
+  return (formatProperties.optimalTilingFeatures & required) == required;
+}
+
 EvTexture ev_vulkan_registerCubeMap(VkFormat format, uint32_t width, uint32_t height, uint32_t layerCount, void** pixels)
 {
   uint32_t layerSize = width * height * 4;
@@ -1026,26 +1419,17 @@ EvTexture ev_vulkan_registerCubeMap(VkFormat format, uint32_t width, uint32_t he
     ev_vulkan_createimage(&imageCreateInfo, &allocationCreateInfo, &newimage);
   }
 
-  EvBuffer imageStagingBuffer;
-  ev_vulkan_allocatestagingbuffer(totalSize, &imageStagingBuffer);
+  StagingRegion stagingRegion;
+  ev_uploadmanager_stage(totalSize, 0, &stagingRegion);
 
   //update staging buffer
+  for (size_t i = 0; i < layerCount; i++)
   {
-    void *mapped;
-    vmaMapMemory(ev_vulkan_getvmaallocator(), imageStagingBuffer.allocation, &mapped);
-    for (size_t i = 0; i < layerCount; i++)
-    {
-      char* dest = (char*)mapped + layerSize * i;
-      memcpy(dest, pixels[i], layerSize);
-    }
-    vmaUnmapMemory(ev_vulkan_getvmaallocator(), imageStagingBuffer.allocation);
+    char* dest = (char*)stagingRegion.mappedData + layerSize * i;
+    memcpy(dest, pixels[i], layerSize);
   }
 
-  ev_vulkan_transitionimagelayout(newimage, format, layerCount, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-  ev_vulkan_copybuffertoimage(imageStagingBuffer.buffer, newimage.image, width, height, layerCount);
-  ev_vulkan_transitionimagelayout(newimage, format, layerCount, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-
-  ev_vulkan_destroybuffer(&imageStagingBuffer);
+  ev_vulkan_uploadimage(&stagingRegion, newimage.image, width, height, layerCount);
 
   VkImageView imageView;
   //create image view
@@ -1068,7 +1452,6 @@ EvTexture ev_vulkan_registerCubeMap(VkFormat format, uint32_t width, uint32_t he
     vkCreateImageView(VulkanData.logicalDevice, &imageViewCreateInfo, NULL, &imageView);
   }
 
-  VkSampler sampler;
   VkSamplerCreateInfo samplerInfo =
   {
       .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
@@ -1088,19 +1471,18 @@ EvTexture ev_vulkan_registerCubeMap(VkFormat format, uint32_t width, uint32_t he
       .minLod = 0.0f,
       .maxLod = 0.0f,
   };
-  vkCreateSampler(VulkanData.logicalDevice, &samplerInfo, NULL, &sampler);
 
   EvTexture evtexture = {
       .image = newimage,
       .imageView = imageView,
-      .sampler = sampler
+      .sampler = ev_samplercache_get(&samplerInfo)
   };
   return evtexture;
 }
 
 void ev_vulkan_destroytexture(EvTexture *texture)
 {
-  vkDestroySampler(VulkanData.logicalDevice, texture->sampler, NULL);
+  // Samplers are owned by the sampler cache
   ev_vulkan_destroyimageview(texture->imageView);
   ev_vulkan_destroyimage(texture->image);
 }
@@ -143,6 +143,11 @@ VmaAllocator ev_vulkan_getvmaallocator();
 VkPhysicalDevice ev_vulkan_getphysicaldevice();
 
 VkCommandPool ev_vulkan_getcommandpool(QueueType type);
+
+// Records into a reused command buffer of the given queue type. The matching
+// end call submits it and blocks until the GPU is done with it.
+VkCommandBuffer ev_vulkan_beginimmediatesubmit(QueueType type);
+void ev_vulkan_endimmediatesubmit(QueueType type);
 void ev_vulkan_createdescriptorpool(VkDescriptorPoolCreateInfo *info, VkDescriptorPool *pool);
 void ev_vulkan_destroydescriptorpool(VkDescriptorPool *pool);
 
@@ -166,6 +171,28 @@ void ev_vulkan_allocatestagingbuffer(unsigned long long bufferSize, EvBuffer *bu
 
 void ev_vulkan_createresourcememorypool(VkBufferUsageFlagBits memoryFlags ,unsigned long long blockSize, unsigned int minBlockCount, unsigned int maxBlockCount, VmaPool *pool);
 
+void ev_vulkan_allocateresourcebuffer(unsigned long long size, EvBuffer *buffer);
+
+// Must be called before `ev_vulkan_init`. The feature only gets enabled if
+// the device supports it, check with `ev_vulkan_hasbufferdeviceaddress`.
+void ev_vulkan_requestbufferdeviceaddress(bool enable);
+bool ev_vulkan_hasbufferdeviceaddress();
+
+VkDeviceAddress ev_vulkan_getbufferaddress(EvBuffer *buffer);
+
+// Must be called before `ev_vulkan_init`. Values of 1 or less keep texture
+// sampling isotropic, larger ones get clamped to the device limit.
+void ev_vulkan_requestsampleranisotropy(float maxAnisotropy);
+
+const VkPhysicalDeviceFeatures *ev_vulkan_getenabledfeatures();
+
+// True when VK_EXT_graphics_pipeline_library got enabled on the device
+bool ev_vulkan_hasgraphicspipelinelibrary();
+
+// True when storage buffer and sampled image bindings can be created with
+// UPDATE_AFTER_BIND and UPDATE_UNUSED_WHILE_PENDING
+bool ev_vulkan_hasdescriptorupdateafterbind();
+
 EvBuffer ev_vulkan_registerbuffer(void *data, unsigned long long size);
 
 void ev_vulkan_destroypipeline(VkPipeline pipeline);
@@ -195,9 +222,24 @@ void ev_vulkan_allocateimageinpool(VmaPool pool, uint32_t width, uint32_t height
 void ev_vulkan_transitionimagelayout(EvImage image, VkFormat format, uint32_t layerCount, VkImageLayout oldLayout, VkImageLayout newLayout);
 void ev_vulkan_copybuffertoimage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, uint32_t layerCount);
 
-EvTexture ev_vulkan_registerTexture(VkFormat format, uint32_t width, uint32_t height, void* pixels);
+// Creates a texture with a full mip chain generated from `pixels`. The
+// source channels get converted to `format`, which must be one of the 8 bit
+// formats handled by `ev_vulkan_getformatchannelcount`.
+EvTexture ev_vulkan_registerTexture(VkFormat format, uint32_t width, uint32_t height, uint32_t srcChannelCount, const void* pixels);
+// `mipPixels` holds one tightly packed level per mip, starting at `width`x`height`
+EvTexture ev_vulkan_registerTextureMips(VkFormat format, uint32_t width, uint32_t height, uint32_t mipCount, void** mipPixels);
+// Same as `ev_vulkan_registerTextureMips` for any format, block compressed
+// ones included, given the size in bytes of every level
+EvTexture ev_vulkan_registerTextureLevels(VkFormat format, uint32_t width, uint32_t height, uint32_t mipCount, const void** levelData, const unsigned long long *levelSizes);
+
+bool ev_vulkan_issampledformatsupported(VkFormat format);
 EvTexture ev_vulkan_registerCubeMap(VkFormat format, uint32_t width, uint32_t height, uint32_t LayerCount, void** pixels);
 
 void ev_vulkan_destroytexture(EvTexture *texture);
 
+// Channel count of the uncompressed 8 bit formats textures use, 0 for any other
+uint32_t ev_vulkan_getformatchannelcount(VkFormat format);
+
+uint32_t ev_vulkan_getmipcount(uint32_t width, uint32_t height);
+
 void ev_vulkan_buildlightPipeline();
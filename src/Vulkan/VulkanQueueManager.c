@@ -4,9 +4,10 @@
 #include <stdlib.h>
 
 // NOTE:
-// Currently, we only allocate 2 queues. One of which is used for Graphics work
-// and the other is used for Compute/Transfer work. While this may seem counter-
-// intuitive and that we should allocate as much queues as possible, the
+// Currently, we allocate at most 3 queues. One for Graphics work, one for
+// Compute work and, when the device exposes a transfer-only queue family
+// (usually backed by a DMA engine), one for Transfer work. While this may seem
+// counter-intuitive and that we should allocate as much queues as possible, the
 // following link provides the reasoning for this decision:
 // https://stackoverflow.com/questions/55272626/what-is-actually-a-queue-family-in-vulkan
 
@@ -35,6 +36,9 @@ struct ev_VulkanQueueManagerData {
   VkQueue** queues;
   unsigned int *queuesAllocCount;
   unsigned int *queuesUseCount;
+
+  // Family picked for every queue type during init
+  unsigned int typeFamilies[QUEUE_TYPE_COUNT];
 } VulkanQueueManagerData;
 
 #define DATA(a) VulkanQueueManagerData.a
@@ -61,8 +65,13 @@ static int ev_vulkanqueuemanager_init(VkPhysicalDevice physicalDevice, VkDeviceQ
 
   unsigned int graphicsIdx = -1;
   unsigned int computeIdx = -1;
+  unsigned int transferIdx = -1;
 
   bool separateCompute = true;
+  bool separateTransfer = true;
+
+  for(unsigned int i = 0; i < QUEUE_TYPE_COUNT; ++i)
+    DATA(typeFamilies)[i] = -1;
 
   for(unsigned int i = 0; i < DATA(queueFamilyCount); ++i)
   {
@@ -97,10 +106,34 @@ static int ev_vulkanqueuemanager_init(VkPhysicalDevice physicalDevice, VkDeviceQ
     separateCompute = false;
   }
 
-  *queueCreateInfosCount = separateCompute?2:1;
+  for(unsigned int i = 0; i < DATA(queueFamilyCount); ++i)
+  {
+    if(    (PROPERTIES[i].queueFlags & VK_QUEUE_TRANSFER_BIT)                            // and the current family support transfer
+        && !(PROPERTIES[i].queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))  // and it's a transfer-only family
+        && (PROPERTIES[i].queueCount > QUEUES_ALLOC_COUNT[i]))                           // and we didn't allocate the current family's maximum queue count
+    {                                                                                    // then
+      transferIdx = i;                                                                   // - Set the transfer queuefamily index to the current queuefamily
+      QUEUES_ALLOC_COUNT[i]++;
+      break;
+    }
+  }
+
+  // Graphics queues implicitly support transfer operations
+  if(transferIdx == -1)
+  {
+    transferIdx = graphicsIdx;
+    separateTransfer = false;
+  }
+
+  DATA(typeFamilies)[GRAPHICS] = graphicsIdx;
+  DATA(typeFamilies)[COMPUTE] = computeIdx;
+  DATA(typeFamilies)[TRANSFER] = transferIdx;
+
+  *queueCreateInfosCount = 1 + (separateCompute?1:0) + (separateTransfer?1:0);
   *queueCreateInfos = malloc(sizeof(VkDeviceQueueCreateInfo) * (*queueCreateInfosCount));
 
-  (*queueCreateInfos)[0] = (VkDeviceQueueCreateInfo)
+  unsigned int createInfoIdx = 0;
+  (*queueCreateInfos)[createInfoIdx++] = (VkDeviceQueueCreateInfo)
     {
       .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
       .queueFamilyIndex = graphicsIdx,
@@ -108,9 +141,9 @@ static int ev_vulkanqueuemanager_init(VkPhysicalDevice physicalDevice, VkDeviceQ
       .pQueuePriorities = &priorityOne,
     };
 
-  if(separateCompute && *queueCreateInfosCount >= 2)
+  if(separateCompute)
   {
-    (*queueCreateInfos)[1] = (VkDeviceQueueCreateInfo)
+    (*queueCreateInfos)[createInfoIdx++] = (VkDeviceQueueCreateInfo)
       {
         .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
         .queueFamilyIndex = computeIdx,
@@ -119,6 +152,19 @@ static int ev_vulkanqueuemanager_init(VkPhysicalDevice physicalDevice, VkDeviceQ
       };
   }
 
+  if(separateTransfer)
+  {
+    (*queueCreateInfos)[createInfoIdx++] = (VkDeviceQueueCreateInfo)
+      {
+        .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+        .queueFamilyIndex = transferIdx,
+        .queueCount = 1,
+        .pQueuePriorities = &priorityOne,
+      };
+  }
+
+  ev_log_debug("Queue families: graphics %u, compute %u, transfer %u", graphicsIdx, computeIdx, transferIdx);
+
   return 0;
 }
 
@@ -140,6 +186,10 @@ static int ev_vulkanqueuemanager_deinit()
 // TODO Change this when time comes
 static VkQueue ev_vulkanqueuemanager_getqueue(QueueType type)
 {
+  unsigned int familyIdx = DATA(typeFamilies)[type];
+  if(familyIdx != -1 && QUEUES_USE_COUNT[familyIdx])
+    return QUEUES[familyIdx][0];
+
   // TODO: A real search and return approach should be implemented.
   for(int i = 0; i < DATA(queueFamilyCount); ++i)
     if((PROPERTIES[i].queueFlags & type) && QUEUES_USE_COUNT[i])
@@ -152,6 +202,10 @@ static VkQueue ev_vulkanqueuemanager_getqueue(QueueType type)
 // TODO Change this when time comes
 static unsigned int ev_vulkanqueuemanager_getfamilyindex(QueueType type)
 {
+  unsigned int familyIdx = DATA(typeFamilies)[type];
+  if(familyIdx != -1 && QUEUES_USE_COUNT[familyIdx])
+    return familyIdx;
+
   // TODO: A real search and return approach should be implemented.
   for(int i = 0; i < DATA(queueFamilyCount); ++i)
     if((PROPERTIES[i].queueFlags & type) && QUEUES_USE_COUNT[i])
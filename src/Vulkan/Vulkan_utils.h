@@ -11,3 +11,4 @@
 
 #define MAX(x1, x2) ( x1 > x2 ? x1:x2)
 #define MIN(x1, x2) ( x1 < x2 ? x1:x2)
+#define ALIGN_UP(x, alignment) ((((x) + (alignment) - 1) / (alignment)) * (alignment))
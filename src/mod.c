@@ -7,17 +7,44 @@
 #include <Pipeline.h>
 #include <Swapchain.h>
 #include <Vulkan_utils.h>
+#include <DescriptorManager.h>
 #include <Renderer_types.h>
 
 #include <VulkanQueueManager.h>
 
 #include <SyncManager/SyncManager.h>
 #include <RenderPass/RenderPass.h>
+#include <UploadManager/UploadManager.h>
+#include <SamplerCache/SamplerCache.h>
+#include <PipelineCache/PipelineCache.h>
+#include <GraphicsLibrary/GraphicsLibrary.h>
+#include <GeometryBuffer/GeometryBuffer.h>
+#include <DescriptorWriter/DescriptorWriter.h>
+#include <TextureStreamer/TextureStreamer.h>
+#include <KTX2/KTX2.h>
+#include <ThreadPool/ThreadPool.h>
+#include <ContentHash/ContentHash.h>
+#include <ShaderArchive/ShaderArchive.h>
 
 #define DEFAULTPIPELINE "DefaultPipeline"
 #define DEFAULTEXTURE "DefaultTexture"
+#define SHADERARCHIVE_PATH "shaders.evsa"
 
 #define BINDLESSARRAYSIZE 2000
+// Material pipelines start with the scene, camera and resources sets
+#define MATERIALPIPELINE_GLOBALSETS 3
+
+// Material pipelines are specialized on the texture slots a material uses:
+//   layout(constant_id = 0) const uint materialFeatures = 0xF;
+// Shaders that don't declare the constant simply ignore it.
+#define MATERIAL_FEATURES_CONSTANT_ID 0
+#define MATERIAL_FEATURE_ALBEDO            (1u << 0)
+#define MATERIAL_FEATURE_NORMAL            (1u << 1)
+#define MATERIAL_FEATURE_METALLICROUGHNESS (1u << 2)
+#define MATERIAL_FEATURE_EMISSIVE          (1u << 3)
+
+#define GEOMETRYPAGESIZE (32ull * 1024 * 1024)
+#define TEXTURESTREAMING_MAXPROMOTIONS 8
 
 #define EV_WINDOW_VULKAN_SUPPORT
 #define IMPORT_MODULE evmod_glfw
@@ -73,27 +100,117 @@ typedef struct {
   Map(evstring, MaterialHandle) map;
   vec(Material) store;
   vec(PipelineHandle) pipelineHandles;
+  // Materials before this index are already in the materials buffer
+  uint32_t uploadedCount;
+  // Number of materials the materials buffer has room for
+  uint32_t bufferCapacity;
   bool dirty;
 } MaterialLibrary;
 
+// Copies of the shaders of a named pipeline, kept to build its variants
+typedef struct {
+  PipelineHandle handle;
+  vec(Shader) shaders;
+} PipelineSource;
+
+typedef struct {
+  PipelineHandle base;
+  uint32_t materialFeatures;
+  PipelineHandle handle;
+} PipelineVariant;
+
 typedef struct {
   Map(evstring, PipelineHandle) map;
   vec(Pipeline) store;
+  vec(PipelineSource) sources;
+  vec(PipelineVariant) variants;
+  // Drawn in place of pipelines that are still compiling
+  PipelineHandle fallback;
+  // Bumped on clear, handles from before that are stale
+  uint32_t generation;
   bool dirty;
 } PipelineLibrary;
 
+typedef struct PipelineBuildJob PipelineBuildJob;
+
+typedef struct {
+  pthread_mutex_t mutex;
+  // Pipelines compiled by the workers, waiting to be swapped in
+  vec(PipelineBuildJob*) ready;
+  // Requested builds that weren't swapped in yet, only touched by the main thread
+  uint32_t pendingCount;
+} PipelineBuilder;
+
+typedef struct {
+  PipelineHandle handle;
+  uint32_t generation;
+  VkPipeline fastLinked;
+  VkPipeline libraries[GRAPHICS_LIBRARY_COUNT];
+  VkPipelineLayout layout;
+  VkPipeline optimized;
+} PipelineOptimizeJob;
+
+typedef struct {
+  VkPipeline pipeline;
+  uint32_t frameNumber;
+} RetiredPipeline;
+
+typedef struct {
+  pthread_mutex_t mutex;
+  // Optimized pipelines compiled by the workers, waiting to be swapped in
+  vec(PipelineOptimizeJob*) ready;
+  // Replaced pipelines that may still be used by frames in flight
+  vec(RetiredPipeline) retired;
+} PipelineOptimizer;
+
+typedef struct {
+  EvTexture texture;
+  uint32_t frameNumber;
+} RetiredTexture;
+
+// A texture slot whose image was replaced, still to be written into the
+// resources set copies of the frame slots in `frameMask`
+typedef struct {
+  uint32_t textureIndex;
+  uint32_t frameMask;
+} PendingTextureSlot;
+
 typedef struct {
   Map(evstring, TextureHandle) map;
   vec(Texture) store;
+  // Content hash (see `ev_renderer_contenthashkey`) to the handle it was first
+  // registered under, so that identical textures under different names share it
+  Map(evstring, TextureHandle) hashes;
+  // Textures before this index are already written into the resources set
+  uint32_t boundCount;
   bool dirty;
 } TextureLibrary;
 
 typedef struct {
   Map(evstring, MeshHandle) map;
   vec(Mesh) store;
+  // Content hash to the handle it was first registered under
+  Map(evstring, MeshHandle) hashes;
+  // Geometry pages before these indices are already written into the resources set
+  uint32_t boundVertexPages;
+  uint32_t boundIndexPages;
   bool dirty;
 } MeshLibrary;
 
+typedef struct {
+  MeshHandle handle;
+  evstring path;
+  // Owns the decoded data in `asset`
+  AssetHandle assetHandle;
+  MeshAsset asset;
+} MeshLoadJob;
+
+typedef struct {
+  pthread_mutex_t mutex;
+  // Meshes decoded by the workers, waiting for their upload
+  vec(MeshLoadJob*) ready;
+} MeshStreamer;
+
 struct ev_Renderer_Data
 {
   FrameData currentFrame;
@@ -106,8 +223,11 @@ struct ev_Renderer_Data
   DescriptorSet resourcesSet;
 
   MeshLibrary meshLibrary;
+  MeshStreamer meshStreamer;
   TextureLibrary textureLibrary;
   PipelineLibrary pipelineLibrary;
+  PipelineBuilder pipelineBuilder;
+  PipelineOptimizer pipelineOptimizer;
   MaterialLibrary materialLibrary;
 
   UBO scenesBuffer;
@@ -117,10 +237,22 @@ struct ev_Renderer_Data
   EvBuffer materialsBuffer;
 
   vec(EvTexture) textureBuffers;
-  vec(EvBuffer)  vertexBuffers;
-  vec(EvBuffer)  indexBuffers;
   vec(EvBuffer)  customBuffers;
 
+  // Batches the descriptor writes of a frame into a single update
+  DescriptorWriter descriptorWriter;
+
+  // Streamed textures whose image was replaced while frames in flight may
+  // still sample the old one
+  vec(PendingTextureSlot) pendingTextureSlots;
+  vec(RetiredTexture) retiredTextures;
+
+  // Bytes of texture and mesh payloads that were aliased instead of uploaded
+  unsigned long long deduplicatedBytes;
+
+  GeometryBuffer vertexGeometry;
+  GeometryBuffer indexGeometry;
+
   Pipeline shadowmapPipeline;
   Pipeline lightPipeline;
   Pipeline skyboxPipeline;
@@ -171,10 +303,17 @@ void ev_renderer_registershadowmapPipeline();
 void ev_renderer_registerLightPipeline();
 void ev_renderer_registerskyboxPipeline();
 void ev_renderer_registerfxaaPipeline();
+void ev_renderer_writepassdescriptors();
 
 void ev_renderer_createSurface();
 
 void ev_renderer_registerCubeMap(CONST_STR imagePath);
+TextureHandle ev_renderer_registerTexture(CONST_STR imagePath, bool srgb);
+
+void ev_renderer_streammeshes();
+void ev_renderer_streamtextures(uint32_t frameNumber);
+void ev_renderer_swapbuiltpipelines();
+void ev_renderer_swapoptimizedpipelines();
 
 void ev_renderer_globalsetsinit()
 {
@@ -213,6 +352,7 @@ void ev_renderer_globalsetsinit()
       });
     }
     VK_ASSERT(vkCreateDescriptorSetLayout(ev_vulkan_getlogicaldevice(), &sceneDescriptorSetLayoutCreateInfo, NULL, &DATA(sceneSet).layout));
+    ev_descriptormanager_registerlayout(DATA(sceneSet).layout, ARRAYSIZE(sceneBindings), sceneBindings);
     ev_descriptormanager_allocate(DATA(sceneSet).layout, &DATA(sceneSet).set[0]);
 
     //sceneBuffer
@@ -243,6 +383,7 @@ void ev_renderer_globalsetsinit()
       });
     }
     VK_ASSERT(vkCreateDescriptorSetLayout(ev_vulkan_getlogicaldevice(), &cameradescriptorSetLayoutCreateInfo, NULL, &DATA(cameraSet).layout));
+    ev_descriptormanager_registerlayout(DATA(cameraSet).layout, ARRAYSIZE(camerabindings), camerabindings);
     ev_descriptormanager_allocate(DATA(cameraSet).layout, &DATA(cameraSet).set[0]);
 
     ev_vulkan_allocateubo(sizeof(CameraData), false, &RendererData.cameraBuffer);
@@ -283,13 +424,30 @@ void ev_renderer_globalsetsinit()
         .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
         .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
       },
+      {
+        // Texture streaming feedback
+        .binding = 5,
+        .descriptorCount = 1,
+        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+      },
     };
+    // New meshes and textures are written into slots that frames in flight
+    // don't read, which doesn't need to wait for them when update after bind
+    // is supported
+    bool updateAfterBind = ev_vulkan_hasdescriptorupdateafterbind();
+    VkDescriptorBindingFlagsEXT bindlessFlags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT;
+    if (updateAfterBind) {
+      bindlessFlags |= VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+    }
+
     VkDescriptorBindingFlagsEXT bindingFlags[] = {
-      VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT,
-      VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT,
-      VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT,
+      bindlessFlags,
+      bindlessFlags,
+      bindlessFlags,
       0,
-      VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT };
+      bindlessFlags,
+      0 };
     VkDescriptorSetLayoutBindingFlagsCreateInfoEXT descriptorSetLayoutBindingFlagsCreateInfo = {
       .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT,
       .bindingCount = ARRAYSIZE(resourcesbindings),
@@ -299,6 +457,7 @@ void ev_renderer_globalsetsinit()
     VkDescriptorSetLayoutCreateInfo resourcesdescriptorSetLayoutCreateInfo =
     {
       .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+      .flags = updateAfterBind ? VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT : 0,
       .bindingCount = ARRAYSIZE(resourcesbindings),
       .pNext = &descriptorSetLayoutBindingFlagsCreateInfo,
       .pBindings = resourcesbindings,
@@ -311,7 +470,18 @@ void ev_renderer_globalsetsinit()
       });
     }
     VK_ASSERT(vkCreateDescriptorSetLayout(ev_vulkan_getlogicaldevice(), &resourcesdescriptorSetLayoutCreateInfo, NULL, &DATA(resourcesSet).layout));
-    ev_descriptormanager_allocate(DATA(resourcesSet).layout, &DATA(resourcesSet).set[0]);
+    ev_descriptormanager_registerlayout(DATA(resourcesSet).layout, ARRAYSIZE(resourcesbindings), resourcesbindings);
+    // One copy per frame slot, a frame slot's copy can be rewritten as soon as
+    // its fence is signaled
+    for (uint32_t frame = 0; frame < framebuffering_degree; frame++) {
+      if (updateAfterBind) {
+        ev_descriptormanager_allocateupdateafterbind(DATA(resourcesSet).layout, &DATA(resourcesSet).set[frame]);
+      } else {
+        ev_descriptormanager_allocate(DATA(resourcesSet).layout, &DATA(resourcesSet).set[frame]);
+      }
+
+      ev_vulkan_writeintobinding(frame, 0, DATA(resourcesSet), &DATA(resourcesSet).pBindings[5], 0, ev_texturestreamer_getfeedbackbuffer());
+    }
   }
 
   //lightsBuffer
@@ -331,7 +501,7 @@ void ev_renderer_globalsetsdinit()
 
   //Resources set
   ev_vulkan_destroybuffer(&RendererData.materialsBuffer);
-  // ev_vulkan_destroysetlayout(RendererData.resourcesSet.layout);
+  ev_vulkan_destroysetlayout(RendererData.resourcesSet.layout);
 }
 
 void setWindow(WindowHandle handle)
@@ -360,6 +530,8 @@ void setWindow(WindowHandle handle)
   ev_renderer_registerskyboxPipeline();
   ev_renderer_registerLightPipeline();
   ev_renderer_registerfxaaPipeline();
+
+  ev_renderer_writepassdescriptors();
 }
 
 void ev_renderer_createoffscreenpass(VkExtent3D passExtent)
@@ -539,8 +711,6 @@ void ev_renderer_createshadowmappass(VkExtent3D passExtent)
 
   for (size_t i = 0; i < SWAPCHAIN_MAX_IMAGES; i++)
   {
-    vkDestroySampler(ev_vulkan_getlogicaldevice(), RendererData.shadowmapPass.framebuffers[i].frameAttachments[0].sampler, NULL);
-
     VkSamplerCreateInfo samplerCreateInfo = {
       .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
       .magFilter = VK_FILTER_LINEAR,
@@ -559,7 +729,7 @@ void ev_renderer_createshadowmappass(VkExtent3D passExtent)
       .minLod = 0.0f,
       .maxLod = 0.0f,
     };
-    vkCreateSampler(ev_vulkan_getlogicaldevice(), &samplerCreateInfo, NULL, &RendererData.shadowmapPass.framebuffers[i].frameAttachments[0].sampler);
+    RendererData.shadowmapPass.framebuffers[i].frameAttachments[0].sampler = ev_samplercache_get(&samplerCreateInfo);
   }
 }
 
@@ -677,17 +847,39 @@ void ev_renderer_createskyboxtpass(VkExtent3D passExtent)
   }
 }
 
-void ev_renderer_registershadowmapPipeline()
+// Looks the shader up in the shader archive first and only goes through the
+// asset manager when it's missing. Assets that had to be loaded are appended
+// to `loadedAssets` when it isn't NULL.
+Shader ev_renderer_loadshader(CONST_STR shaderPath, ShaderAssetStage assetStage, VkShaderStageFlags stage, vec(AssetHandle) *loadedAssets)
 {
-  AssetHandle vertAsset= Asset->load("shaders://shadowmap.vert");
-  ShaderAsset shaderVertAsset = ShaderLoader->loadAsset(vertAsset, EV_SHADERASSETSTAGE_VERTEX, "shadowmap.vert", NULL, EV_SHADER_BIN);
+  // Archive entries are named after the path without its scheme
+  const char *scheme = strstr(shaderPath, "://");
+  const char *shaderName = scheme ? scheme + 3 : shaderPath;
+
+  Shader shader;
+  if (ev_shaderarchive_get(shaderName, &shader)) {
+    DEBUG_ASSERT(shader.stage == stage);
+    return shader;
+  }
 
+  AssetHandle asset = Asset->load(shaderPath);
+  if (loadedAssets) {
+    vec_push(loadedAssets, &asset);
+  }
+
+  ShaderAsset shaderAsset = ShaderLoader->loadAsset(asset, assetStage, shaderName, NULL, EV_SHADER_BIN);
+
+  return (Shader) {
+    .data = shaderAsset.binary,
+    .length = shaderAsset.len,
+    .stage = stage,
+  };
+}
+
+void ev_renderer_registershadowmapPipeline()
+{
   Shader shaders[] = {
-    {
-      .data = shaderVertAsset.binary,
-      .length = shaderVertAsset.len,
-      .stage = VK_SHADER_STAGE_VERTEX_BIT,
-    },
+    ev_renderer_loadshader("shaders://shadowmap.vert", EV_SHADERASSETSTAGE_VERTEX, VK_SHADER_STAGE_VERTEX_BIT, NULL),
   };
 
   RendererData.shadowmapPipeline.pSets = vec_init(DescriptorSet);
@@ -763,23 +955,9 @@ void ev_renderer_registershadowmapPipeline()
 
 void ev_renderer_registerLightPipeline()
 {
-  AssetHandle vertAsset= Asset->load("shaders://deferred.vert");
-  ShaderAsset shaderVertAsset = ShaderLoader->loadAsset(vertAsset, EV_SHADERASSETSTAGE_VERTEX, "deferred.vert", NULL, EV_SHADER_BIN);
-
-  AssetHandle fragAsset = Asset->load("shaders://deferred.frag");
-  ShaderAsset shaderFragAsset = ShaderLoader->loadAsset(fragAsset, EV_SHADERASSETSTAGE_FRAGMENT, "deferred.frag", NULL, EV_SHADER_BIN);
-
   Shader shaders[] = {
-    {
-      .data = shaderVertAsset.binary,
-      .length = shaderVertAsset.len,
-      .stage = VK_SHADER_STAGE_VERTEX_BIT,
-    },
-    {
-      .data = shaderFragAsset.binary,
-      .length = shaderFragAsset.len,
-      .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
-    },
+    ev_renderer_loadshader("shaders://deferred.vert", EV_SHADERASSETSTAGE_VERTEX, VK_SHADER_STAGE_VERTEX_BIT, NULL),
+    ev_renderer_loadshader("shaders://deferred.frag", EV_SHADERASSETSTAGE_FRAGMENT, VK_SHADER_STAGE_FRAGMENT_BIT, NULL),
   };
 
   RendererData.lightPipeline.pSets = vec_init(DescriptorSet);
@@ -840,23 +1018,9 @@ void ev_renderer_registerskyboxPipeline()
 {
   RendererData.skyboxPipeline.pSets = vec_init(DescriptorSet);
 
-  AssetHandle vertAsset= Asset->load("shaders://skybox.vert");
-  ShaderAsset shaderVertAsset = ShaderLoader->loadAsset(vertAsset, EV_SHADERASSETSTAGE_VERTEX, "skybox.vert", NULL, EV_SHADER_BIN);
-
-  AssetHandle fragAsset = Asset->load("shaders://skybox.frag");
-  ShaderAsset shaderFragAsset = ShaderLoader->loadAsset(fragAsset, EV_SHADERASSETSTAGE_FRAGMENT, "skybox.frag", NULL, EV_SHADER_BIN);
-
   Shader shaders[] = {
-    {
-      .data = shaderVertAsset.binary,
-      .length = shaderVertAsset.len,
-      .stage = VK_SHADER_STAGE_VERTEX_BIT,
-    },
-    {
-      .data = shaderFragAsset.binary,
-      .length = shaderFragAsset.len,
-      .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
-    },
+    ev_renderer_loadshader("shaders://skybox.vert", EV_SHADERASSETSTAGE_VERTEX, VK_SHADER_STAGE_VERTEX_BIT, NULL),
+    ev_renderer_loadshader("shaders://skybox.frag", EV_SHADERASSETSTAGE_FRAGMENT, VK_SHADER_STAGE_FRAGMENT_BIT, NULL),
   };
 
   VkPipelineColorBlendAttachmentState pipelineColorBlendAttachmentState = {
@@ -937,23 +1101,9 @@ void ev_renderer_registerfxaaPipeline()
 {
   RendererData.fxaaPipeline.pSets = vec_init(DescriptorSet);
 
-  AssetHandle vertAsset= Asset->load("shaders://fxaa.vert");
-  ShaderAsset shaderVertAsset = ShaderLoader->loadAsset(vertAsset, EV_SHADERASSETSTAGE_VERTEX, "fxaa.vert", NULL, EV_SHADER_BIN);
-
-  AssetHandle fragAsset = Asset->load("shaders://fxaa.frag");
-  ShaderAsset shaderFragAsset = ShaderLoader->loadAsset(fragAsset, EV_SHADERASSETSTAGE_FRAGMENT, "fxaa.frag", NULL, EV_SHADER_BIN);
-
   Shader shaders[] = {
-    {
-      .data = shaderVertAsset.binary,
-      .length = shaderVertAsset.len,
-      .stage = VK_SHADER_STAGE_VERTEX_BIT,
-    },
-    {
-      .data = shaderFragAsset.binary,
-      .length = shaderFragAsset.len,
-      .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
-    },
+    ev_renderer_loadshader("shaders://fxaa.vert", EV_SHADERASSETSTAGE_VERTEX, VK_SHADER_STAGE_VERTEX_BIT, NULL),
+    ev_renderer_loadshader("shaders://fxaa.frag", EV_SHADERASSETSTAGE_FRAGMENT, VK_SHADER_STAGE_FRAGMENT_BIT, NULL),
   };
 
   VkPipelineColorBlendAttachmentState pipelineColorBlendAttachmentState = {
@@ -1000,6 +1150,28 @@ void ev_renderer_registerfxaaPipeline()
     }
 }
 
+// Points the per-image sets of the light and fxaa pipelines at the
+// attachments of the matching framebuffers. Has to run again whenever the
+// pass attachments or these pipelines are recreated.
+void ev_renderer_writepassdescriptors()
+{
+  for (size_t i = 0; i < SWAPCHAIN_MAX_IMAGES; i++)
+  {
+    Framebuffer framebuffer = RendererData.offscreenPass.framebuffers[i];
+    for (size_t j = 0; j < 4; j++) {
+      ev_descriptorwriter_write(&DATA(descriptorWriter), i, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, DATA(lightPipeline.pSets[0]), &DATA(lightPipeline.pSets[0]).pBindings[j], 0, &framebuffer.frameAttachments[j]);
+    }
+
+    framebuffer = RendererData.shadowmapPass.framebuffers[i];
+    ev_descriptorwriter_write(&DATA(descriptorWriter), i, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, DATA(lightPipeline.pSets[0]), &DATA(lightPipeline.pSets[0]).pBindings[4], 0, &framebuffer.frameAttachments[0]);
+
+    framebuffer = RendererData.lightPass.framebuffers[i];
+    ev_descriptorwriter_write(&DATA(descriptorWriter), i, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, DATA(fxaaPipeline.pSets[0]), &DATA(fxaaPipeline.pSets[0]).pBindings[0], 0, &framebuffer.frameAttachments[0]);
+  }
+
+  ev_descriptorwriter_flush(&DATA(descriptorWriter));
+}
+
 void ev_renderer_updatewindowsize()
 {
   EvSwapchain *swapchain = ev_vulkan_getSwapchain();
@@ -1022,40 +1194,81 @@ void ev_renderer_destroysurface(VkSurfaceKHR surface)
 
 void run()
 {
+  ev_renderer_streammeshes();
+
   if (DATA(materialLibrary).dirty)
   {
-    ev_vulkan_wait();
-    size_t materialBufferLength = MAX(vec_len(RendererData.materialLibrary.store), vec_capacity(RendererData.materialLibrary.store));
-    RendererData.materialsBuffer = ev_vulkan_registerbuffer(RendererData.materialLibrary.store, sizeof(Material) * materialBufferLength);
-    ev_vulkan_writeintobinding(0, 0, DATA(resourcesSet), &DATA(resourcesSet).pBindings[3], 0, &RendererData.materialsBuffer);
+    MaterialLibrary *library = &DATA(materialLibrary);
+    uint32_t materialCount = vec_len(library->store);
+
+    if (materialCount > library->bufferCapacity) {
+      // Frames in flight read the current buffer through its descriptor
+      ev_vulkan_wait();
+      if (library->bufferCapacity > 0) {
+        ev_vulkan_destroybuffer(&RendererData.materialsBuffer);
+      }
 
-    DATA(materialLibrary).dirty = false;
+      library->bufferCapacity = MAX(materialCount, MAX(library->bufferCapacity * 2, vec_capacity(library->store)));
+      ev_vulkan_allocateresourcebuffer(sizeof(Material) * library->bufferCapacity, &RendererData.materialsBuffer);
+      for (uint32_t frame = 0; frame < framebuffering_degree; frame++) {
+        ev_vulkan_writeintobinding(frame, 0, DATA(resourcesSet), &DATA(resourcesSet).pBindings[3], 0, &RendererData.materialsBuffer);
+      }
+      library->uploadedCount = 0;
+    }
+
+    // Appended materials land past everything frames in flight can index
+    ev_uploadmanager_uploadbuffer(library->store + library->uploadedCount,
+        sizeof(Material) * (materialCount - library->uploadedCount),
+        &RendererData.materialsBuffer, sizeof(Material) * library->uploadedCount);
+    library->uploadedCount = materialCount;
+
+    library->dirty = false;
   }
 
+  // Only slots added since the last frame are written, the rest of the set
+  // is untouched
   if (DATA(meshLibrary).dirty)
   {
-    ev_vulkan_wait();
-    for (size_t i = 0; i < vec_len(RendererData.indexBuffers); i++) {
-      ev_vulkan_writeintobinding(0, 0, DATA(resourcesSet), &DATA(resourcesSet).pBindings[2], i, &(DATA(indexBuffers)[i].buffer));
+    for (uint32_t frame = 0; frame < framebuffering_degree; frame++) {
+      for (size_t i = DATA(meshLibrary).boundIndexPages; i < vec_len(RendererData.indexGeometry.pages); i++) {
+        ev_descriptorwriter_write(&DATA(descriptorWriter), frame, 0, DATA(resourcesSet), &DATA(resourcesSet).pBindings[2], i, &(DATA(indexGeometry).pages[i].buffer.buffer));
+      }
     }
+    DATA(meshLibrary).boundIndexPages = vec_len(RendererData.indexGeometry.pages);
 
-    for (size_t i = 0; i < vec_len(RendererData.vertexBuffers); i++) {
-      ev_vulkan_writeintobinding(0, 0, DATA(resourcesSet), &DATA(resourcesSet).pBindings[1], i, &(DATA(vertexBuffers)[i].buffer));
+    for (uint32_t frame = 0; frame < framebuffering_degree; frame++) {
+      for (size_t i = DATA(meshLibrary).boundVertexPages; i < vec_len(RendererData.vertexGeometry.pages); i++) {
+        ev_descriptorwriter_write(&DATA(descriptorWriter), frame, 0, DATA(resourcesSet), &DATA(resourcesSet).pBindings[1], i, &(DATA(vertexGeometry).pages[i].buffer.buffer));
+      }
     }
+    DATA(meshLibrary).boundVertexPages = vec_len(RendererData.vertexGeometry.pages);
 
     DATA(meshLibrary).dirty = false;
   }
 
   if (DATA(textureLibrary).dirty)
   {
-    ev_vulkan_wait();
-    for (size_t i = 0; i < vec_len(RendererData.textureBuffers); i++) {
-      ev_vulkan_writeintobinding(0, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, DATA(resourcesSet), &DATA(resourcesSet).pBindings[4], i, &(DATA(textureBuffers)[i]));
+    for (uint32_t frame = 0; frame < framebuffering_degree; frame++) {
+      for (size_t i = DATA(textureLibrary).boundCount; i < vec_len(RendererData.textureBuffers); i++) {
+        ev_descriptorwriter_write(&DATA(descriptorWriter), frame, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, DATA(resourcesSet), &DATA(resourcesSet).pBindings[4], i, &(DATA(textureBuffers)[i]));
+      }
     }
+    DATA(textureLibrary).boundCount = vec_len(RendererData.textureBuffers);
 
     DATA(textureLibrary).dirty = false;
   }
 
+  if (vec_len(DATA(descriptorWriter).writes))
+  {
+    if (!ev_vulkan_hasdescriptorupdateafterbind()) {
+      ev_vulkan_wait();
+    }
+    ev_descriptorwriter_flush(&DATA(descriptorWriter));
+  }
+
+  // Push every upload recorded since the last frame ahead of this frame's work
+  ev_uploadmanager_flush();
+
   if (RendererData.windowResized)
   {
     ev_vulkan_recreateSwapChain();
@@ -1075,21 +1288,17 @@ void run()
   };
 
   VK_ASSERT(vkWaitForFences(ev_vulkan_getlogicaldevice(), 1, &swapchain->renderFences[frameNumber], true, ~0ull));
-  VK_ASSERT(vkResetFences(ev_vulkan_getlogicaldevice(), 1, &swapchain->renderFences[frameNumber]));
 
-  vkAcquireNextImageKHR(ev_vulkan_getlogicaldevice(), swapchain->swapchain, ~0ull, swapchain->presentSemaphores[frameNumber], NULL, &swapchainImageIndex);
+  // The feedback written by this frame slot is available now that its fence is signaled
+  ev_renderer_streamtextures(frameNumber);
+
+  ev_renderer_swapbuiltpipelines();
+  ev_renderer_swapoptimizedpipelines();
 
-  Framebuffer framebuffer = RendererData.offscreenPass.framebuffers[swapchainImageIndex];
-  ev_vulkan_writeintobinding(swapchainImageIndex, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, DATA(lightPipeline.pSets[0]), &DATA(lightPipeline.pSets[0]).pBindings[0], 0, &framebuffer.frameAttachments[0]);
-  ev_vulkan_writeintobinding(swapchainImageIndex, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, DATA(lightPipeline.pSets[0]), &DATA(lightPipeline.pSets[0]).pBindings[1], 0, &framebuffer.frameAttachments[1]);
-  ev_vulkan_writeintobinding(swapchainImageIndex, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, DATA(lightPipeline.pSets[0]), &DATA(lightPipeline.pSets[0]).pBindings[2], 0, &framebuffer.frameAttachments[2]);
-  ev_vulkan_writeintobinding(swapchainImageIndex, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, DATA(lightPipeline.pSets[0]), &DATA(lightPipeline.pSets[0]).pBindings[3], 0, &framebuffer.frameAttachments[3]);
+  VK_ASSERT(vkResetFences(ev_vulkan_getlogicaldevice(), 1, &swapchain->renderFences[frameNumber]));
 
-  framebuffer = RendererData.shadowmapPass.framebuffers[swapchainImageIndex];
-  ev_vulkan_writeintobinding(swapchainImageIndex, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, DATA(lightPipeline.pSets[0]), &DATA(lightPipeline.pSets[0]).pBindings[4], 0, &framebuffer.frameAttachments[0]);
+  vkAcquireNextImageKHR(ev_vulkan_getlogicaldevice(), swapchain->swapchain, ~0ull, swapchain->presentSemaphores[frameNumber], NULL, &swapchainImageIndex);
 
-  framebuffer = RendererData.lightPass.framebuffers[swapchainImageIndex];
-  ev_vulkan_writeintobinding(swapchainImageIndex, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, DATA(fxaaPipeline.pSets[0]), &DATA(fxaaPipeline.pSets[0]).pBindings[0], 0, &framebuffer.frameAttachments[0]);
 
   ev_vulkan_updateubo(sizeof(LightObject) * vec_len(DATA(currentFrame).lightObjects), RendererData.currentFrame.lightObjects, &(DATA(lightsBuffer).buffer));
   /////////////////////////////
@@ -1099,6 +1308,8 @@ void run()
     VK_ASSERT(vkResetCommandBuffer(cmd, 0));
     VK_ASSERT(vkBeginCommandBuffer(cmd, &cmdBeginInfo));
 
+    ev_texturestreamer_resetfeedback(cmd);
+
     VkClearValue clearValuesoffscreen[] =
     {
       {
@@ -1162,20 +1373,42 @@ void run()
 
     ev_vulkan_updateubo(sizeof(CameraData), &cam, &DATA(cameraBuffer));
 
-    VkPipeline oldPipeline;
+    bool bufferDeviceAddress = ev_vulkan_hasbufferdeviceaddress();
+    // Stop right after materialIndex, the addresses are 8-byte aligned
+    uint32_t pushConstantsSize = bufferDeviceAddress ? sizeof(MeshPushConstants) : offsetof(MeshPushConstants, materialIndex) + sizeof(uint32_t);
+
+    VkPipeline oldPipeline = VK_NULL_HANDLE;
+    // Compatible pipelines share their layout and sets, which then stay bound
+    VkPipelineLayout boundLayout = VK_NULL_HANDLE;
+    VkDescriptorSet boundSets[4];
+    uint32_t boundSetCount = 0;
     for (size_t componentIndex = 0; componentIndex < vec_len(DATA(currentFrame).objectComponents); componentIndex++)
     {
       RenderComponent component = DATA(currentFrame).objectComponents[componentIndex];
-      ev_log_debug("mesh # %d, vertexbuffer: %d, indexbuffer: %d", componentIndex, component.mesh.vertexBufferIndex, component.mesh.indexBufferIndex);
+      Mesh mesh = DATA(meshLibrary).store[component.meshIndex];
+      // Placeholder of a mesh that isn't uploaded yet
+      if (mesh.indexCount == 0)
+        continue;
+      ev_log_debug("mesh # %d, vertexbuffer: %d, indexbuffer: %d", componentIndex, mesh.vertexBufferIndex, mesh.indexBufferIndex);
       Pipeline pipeline = DATA(pipelineLibrary.store[component.pipelineIndex]);
+      // Still compiling, draw it with the fallback until it's swapped in
+      if (!pipeline.pipeline) {
+        if (DATA(pipelineLibrary).fallback == INVALID_PIPELINE_HANDLE)
+          continue;
+        pipeline = DATA(pipelineLibrary.store[DATA(pipelineLibrary).fallback]);
+      }
 
       MeshPushConstants pushconstant;
       memcpy(pushconstant.transform, DATA(currentFrame).objectTranforms[componentIndex], sizeof(Matrix4x4));
-      pushconstant.indexBufferIndex = component.mesh.indexBufferIndex;
-      pushconstant.vertexBufferIndex = component.mesh.indexBufferIndex;
+      pushconstant.indexBufferIndex = mesh.indexBufferIndex;
+      pushconstant.vertexBufferIndex = mesh.vertexBufferIndex;
       pushconstant.materialIndex = component.materialIndex;
+      if (bufferDeviceAddress) {
+        pushconstant.indexBufferAddress = DATA(indexGeometry).pages[mesh.indexBufferIndex].address;
+        pushconstant.vertexBufferAddress = DATA(vertexGeometry).pages[mesh.vertexBufferIndex].address;
+      }
 
-      vkCmdPushConstants(cmd, pipeline.pipelineLayout, VK_SHADER_STAGE_ALL_GRAPHICS, 0, sizeof(MeshPushConstants), &pushconstant);
+      vkCmdPushConstants(cmd, pipeline.pipelineLayout, VK_SHADER_STAGE_ALL_GRAPHICS, 0, pushConstantsSize, &pushconstant);
 
       if (oldPipeline != pipeline.pipeline)
       {
@@ -1190,14 +1423,24 @@ void run()
 
       ds[0] = DATA(sceneSet).set[0];
       ds[1] = DATA(cameraSet).set[0];
-      ds[2] = DATA(resourcesSet).set[0];
+      ds[2] = DATA(resourcesSet).set[frameNumber];
 
-      vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.pipelineLayout, 0, vec_len(pipeline.pSets), ds, 0, 0);
+      uint32_t setCount = vec_len(pipeline.pSets);
+      if (boundLayout != pipeline.pipelineLayout || boundSetCount != setCount || memcmp(boundSets, ds, setCount * sizeof(VkDescriptorSet)))
+      {
+        vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.pipelineLayout, 0, setCount, ds, 0, 0);
+        boundLayout = pipeline.pipelineLayout;
+        boundSetCount = setCount;
+        memcpy(boundSets, ds, setCount * sizeof(VkDescriptorSet));
+      }
 
-      vkCmdDraw(cmd, component.mesh.indexCount, 1, 0, 0);
+      vkCmdDraw(cmd, mesh.indexCount, 1, mesh.indexOffset, 0);
     }
 
     vkCmdEndRenderPass(cmd);
+
+    ev_texturestreamer_readbackfeedback(cmd, frameNumber);
+
     VK_ASSERT(vkEndCommandBuffer(cmd));
 
     VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
@@ -1274,18 +1517,33 @@ void run()
       vkCmdSetViewport(cmd, 0, 1, &viewport);
     }
 
-    VkPipeline oldPipeline;
+    bool bufferDeviceAddress = ev_vulkan_hasbufferdeviceaddress();
+    uint32_t pushConstantsSize = bufferDeviceAddress ? sizeof(ShadowmapPushConstants) : offsetof(ShadowmapPushConstants, indexBufferAddress);
+
+    VkPipeline oldPipeline = VK_NULL_HANDLE;
+    // Compatible pipelines share their layout and sets, which then stay bound
+    VkPipelineLayout boundLayout = VK_NULL_HANDLE;
+    VkDescriptorSet boundSets[4];
+    uint32_t boundSetCount = 0;
     for (size_t componentIndex = 0; componentIndex < vec_len(DATA(currentFrame).objectComponents); componentIndex++)
     {
       RenderComponent component = DATA(currentFrame).objectComponents[componentIndex];
+      Mesh mesh = DATA(meshLibrary).store[component.meshIndex];
+      // Placeholder of a mesh that isn't uploaded yet
+      if (mesh.indexCount == 0)
+        continue;
       Pipeline pipeline = RendererData.shadowmapPipeline;
 
       ShadowmapPushConstants pushconstant;
       memcpy(pushconstant.transform, DATA(currentFrame).objectTranforms[componentIndex], sizeof(Matrix4x4));
-      pushconstant.indexBufferIndex = component.mesh.indexBufferIndex;
-      pushconstant.vertexBufferIndex = component.mesh.indexBufferIndex;
+      pushconstant.indexBufferIndex = mesh.indexBufferIndex;
+      pushconstant.vertexBufferIndex = mesh.vertexBufferIndex;
+      if (bufferDeviceAddress) {
+        pushconstant.indexBufferAddress = DATA(indexGeometry).pages[mesh.indexBufferIndex].address;
+        pushconstant.vertexBufferAddress = DATA(vertexGeometry).pages[mesh.vertexBufferIndex].address;
+      }
 
-      vkCmdPushConstants(cmd, pipeline.pipelineLayout, VK_SHADER_STAGE_ALL_GRAPHICS, 0, sizeof(ShadowmapPushConstants), &pushconstant);
+      vkCmdPushConstants(cmd, pipeline.pipelineLayout, VK_SHADER_STAGE_ALL_GRAPHICS, 0, pushConstantsSize, &pushconstant);
 
       if (oldPipeline != pipeline.pipeline)
       {
@@ -1298,11 +1556,18 @@ void run()
         ds[i] = pipeline.pSets[i].set[0];
       }
 
-      ds[0] = DATA(resourcesSet).set[0];
+      ds[0] = DATA(resourcesSet).set[frameNumber];
 
-      vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.pipelineLayout, 0, vec_len(pipeline.pSets), ds, 0, 0);
+      uint32_t setCount = vec_len(pipeline.pSets);
+      if (boundLayout != pipeline.pipelineLayout || boundSetCount != setCount || memcmp(boundSets, ds, setCount * sizeof(VkDescriptorSet)))
+      {
+        vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.pipelineLayout, 0, setCount, ds, 0, 0);
+        boundLayout = pipeline.pipelineLayout;
+        boundSetCount = setCount;
+        memcpy(boundSets, ds, setCount * sizeof(VkDescriptorSet));
+      }
 
-      vkCmdDraw(cmd, component.mesh.indexCount, 1, 0, 0);
+      vkCmdDraw(cmd, mesh.indexCount, 1, mesh.indexOffset, 0);
     }
 
     vkCmdEndRenderPass(cmd);
@@ -1711,47 +1976,564 @@ PipelineHandle ev_renderer_getPipeline(CONST_STR pipelineName)
   return INVALID_PIPELINE_HANDLE;
 }
 
-PipelineHandle ev_renderer_registerPipeline(CONST_STR pipelineName, vec(Shader) *shaders)
+// Compiles a material pipeline for the offscreen pass. Only reads renderer
+// state, so it is safe to run on the worker threads.
+void ev_renderer_buildpipeline(vec(Shader) shaders, const VkSpecializationInfo *specializationInfo, Pipeline *pipeline)
 {
-  PipelineHandle *handle = Hashmap(evstring, PipelineHandle).get(DATA(pipelineLibrary).map, pipelineName);
-
-  if (handle) {
-    return *handle;
-  }
-
-  Pipeline newPipeline;
-  newPipeline.pSets = vec_init(DescriptorSet);
+  pipeline->pSets = vec_init(DescriptorSet);
 
   EvGraphicsPipelineCreateInfo pipelineCreateInfo = {
-    .stageCount = vec_len(*shaders),
-    .pShaders = *shaders,
+    .stageCount = vec_len(shaders),
+    .pShaders = shaders,
+    .pSpecializationInfo = specializationInfo,
     .renderPass = RendererData.offscreenPass.renderPass,
   };
 
+  // The first MATERIALPIPELINE_GLOBALSETS sets
   vec(DescriptorSet) overrides = vec_init(DescriptorSet);
   vec_push(&overrides, &RendererData.sceneSet);
   vec_push(&overrides, &RendererData.cameraSet);
   vec_push(&overrides, &RendererData.resourcesSet);
-  ev_pipeline_build(pipelineCreateInfo, overrides, &newPipeline);
+  ev_pipeline_build(pipelineCreateInfo, overrides, pipeline);
   vec_fini(overrides);
+}
+
+void ev_renderer_optimizepipelinejob(void *data)
+{
+  PipelineOptimizeJob *job = data;
+  job->optimized = ev_graphicslibrary_link(job->libraries, job->layout, true);
+
+  pthread_mutex_lock(&DATA(pipelineOptimizer).mutex);
+  vec_push(&DATA(pipelineOptimizer).ready, &job);
+  pthread_mutex_unlock(&DATA(pipelineOptimizer).mutex);
+}
+
+// Compiles the link time optimized version of a fast linked pipeline in the
+// background, the fast linked one is used until it's swapped in
+void ev_renderer_optimizepipeline(PipelineHandle handle, const Pipeline *pipeline)
+{
+  PipelineOptimizeJob *job = malloc(sizeof(PipelineOptimizeJob));
+  job->handle = handle;
+  job->generation = DATA(pipelineLibrary).generation;
+  job->fastLinked = pipeline->pipeline;
+  memcpy(job->libraries, pipeline->libraries, sizeof(job->libraries));
+  job->layout = pipeline->pipelineLayout;
+  ev_threadpool_submitbackground(ev_renderer_optimizepipelinejob, job);
+}
+
+// Swaps in the optimized pipelines that are done compiling. Must be called
+// right after waiting on the frame's fence, the pipelines they replace are
+// destroyed once every frame in flight that may use them is done.
+void ev_renderer_swapoptimizedpipelines()
+{
+  PipelineOptimizer *optimizer = &DATA(pipelineOptimizer);
+
+  size_t retiredCount = 0;
+  for (size_t i = 0; i < vec_len(optimizer->retired); i++) {
+    if (RendererData.frameNumber >= optimizer->retired[i].frameNumber + framebuffering_degree) {
+      ev_vulkan_destroypipeline(optimizer->retired[i].pipeline);
+    }
+    else {
+      optimizer->retired[retiredCount++] = optimizer->retired[i];
+    }
+  }
+  vec_setlen(&optimizer->retired, retiredCount);
+
+  pthread_mutex_lock(&optimizer->mutex);
+
+  for (size_t i = 0; i < vec_len(optimizer->ready); i++) {
+    PipelineOptimizeJob *job = optimizer->ready[i];
+
+    Pipeline *pipeline = NULL;
+    if (job->generation == DATA(pipelineLibrary).generation && job->handle < vec_len(DATA(pipelineLibrary).store)) {
+      pipeline = &DATA(pipelineLibrary).store[job->handle];
+    }
+
+    // The pipeline was destroyed while its optimized version was compiling
+    if (!pipeline || pipeline->pipeline != job->fastLinked) {
+      ev_vulkan_destroypipeline(job->optimized);
+    }
+    else {
+      vec_push(&optimizer->retired, &(RetiredPipeline) {
+        .pipeline = pipeline->pipeline,
+        .frameNumber = RendererData.frameNumber,
+      });
+      pipeline->pipeline = job->optimized;
+      memset(pipeline->libraries, 0, sizeof(pipeline->libraries));
+    }
+
+    free(job);
+  }
+  vec_clear(optimizer->ready);
+
+  pthread_mutex_unlock(&optimizer->mutex);
+}
+
+// Allocates the pipeline's own sets. Material pipelines never write their
+// own sets, so pipelines with the same set layout share one allocation.
+void ev_renderer_allocatepipelinesets(Pipeline *pipeline)
+{
+  for (size_t i = MATERIALPIPELINE_GLOBALSETS; i < vec_len(pipeline->pSets); i++)
+  {
+    Pipeline *compatible = NULL;
+    for (size_t p = 0; p < vec_len(RendererData.pipelineLibrary.store) && !compatible; p++) {
+      Pipeline *candidate = &RendererData.pipelineLibrary.store[p];
+      if (vec_len(candidate->pSets) > i && candidate->pSets[i].layout == pipeline->pSets[i].layout)
+        compatible = candidate;
+    }
+
+    if (compatible) {
+      memcpy(pipeline->pSets[i].set, compatible->pSets[i].set, sizeof(pipeline->pSets[i].set));
+      continue;
+    }
 
-  for (size_t i = 0; i < vec_len(newPipeline.pSets); i++)
     for (size_t j = 0; j < SWAPCHAIN_MAX_IMAGES; j++) {
-      ev_descriptormanager_allocate(newPipeline.pSets[i].layout, &newPipeline.pSets[i].set[j]);
+      ev_descriptormanager_allocate(pipeline->pSets[i].layout, &pipeline->pSets[i].set[j]);
     }
+  }
+}
+
+// Shaders from the archive stay mapped until shutdown, only their
+// descriptions are copied
+vec(Shader) ev_renderer_copyshaders(vec(Shader) shaders)
+{
+  vec(Shader) copies = vec_init(Shader);
+  for (size_t i = 0; i < vec_len(shaders); i++) {
+    Shader shader = shaders[i];
+    if (!shader.reflection) {
+      shader.data = malloc(shader.length);
+      memcpy(shader.data, shaders[i].data, shader.length);
+    }
+    vec_push(&copies, &shader);
+  }
+  return copies;
+}
+
+void ev_renderer_freeshaders(vec(Shader) shaders)
+{
+  for (size_t i = 0; i < vec_len(shaders); i++)
+    if (!shaders[i].reflection)
+      free(shaders[i].data);
+  vec_fini(shaders);
+}
+
+// Adds the name to the library and keeps a copy of `shaders` for the
+// variants of the pipeline
+void ev_renderer_namepipeline(CONST_STR pipelineName, PipelineHandle handle, vec(Shader) shaders)
+{
+  Hashmap(evstring, PipelineHandle).push(DATA(pipelineLibrary).map, evstring_new(pipelineName), handle);
+
+  PipelineSource source = {
+    .handle = handle,
+    .shaders = ev_renderer_copyshaders(shaders),
+  };
+  vec_push(&DATA(pipelineLibrary).sources, &source);
+}
+
+PipelineHandle ev_renderer_addpipeline(Pipeline *pipeline)
+{
+  ev_renderer_allocatepipelinesets(pipeline);
 
-  PipelineHandle new_handle = (PipelineHandle)vec_push(&RendererData.pipelineLibrary.store, &newPipeline);
-  Hashmap(evstring, MaterialHandle).push(DATA(pipelineLibrary).map, evstring_new(pipelineName), new_handle);
+  PipelineHandle new_handle = (PipelineHandle)vec_push(&RendererData.pipelineLibrary.store, pipeline);
+
+  if (pipeline->libraries[0]) {
+    ev_renderer_optimizepipeline(new_handle, pipeline);
+  }
 
   return new_handle;
 }
 
+struct PipelineBuildJob {
+  PipelineHandle handle;
+  uint32_t generation;
+  vec(Shader) shaders;
+  VkSpecializationInfo specializationInfo;
+  Pipeline pipeline;
+};
+
+void freePipelineBuildJob(PipelineBuildJob *job)
+{
+  ev_renderer_freeshaders(job->shaders);
+  free((void*)job->specializationInfo.pMapEntries);
+  free((void*)job->specializationInfo.pData);
+  free(job);
+}
+
+void ev_renderer_buildpipelinejob(void *data)
+{
+  PipelineBuildJob *job = data;
+  const VkSpecializationInfo *specializationInfo = job->specializationInfo.mapEntryCount ? &job->specializationInfo : NULL;
+  ev_renderer_buildpipeline(job->shaders, specializationInfo, &job->pipeline);
+
+  pthread_mutex_lock(&DATA(pipelineBuilder).mutex);
+  vec_push(&DATA(pipelineBuilder).ready, &job);
+  pthread_mutex_unlock(&DATA(pipelineBuilder).mutex);
+}
+
+// Returns right away. Until the pipeline is compiled in the background its
+// library entry has no VkPipeline and is drawn with the fallback pipeline.
+PipelineHandle ev_renderer_buildpipelineasync(vec(Shader) shaders, const VkSpecializationInfo *specializationInfo)
+{
+  Pipeline placeholderPipeline = {
+    .pSets = vec_init(DescriptorSet),
+  };
+  PipelineHandle new_handle = (PipelineHandle)vec_push(&RendererData.pipelineLibrary.store, &placeholderPipeline);
+
+  PipelineBuildJob *job = malloc(sizeof(PipelineBuildJob));
+  job->handle = new_handle;
+  job->generation = DATA(pipelineLibrary).generation;
+  job->shaders = ev_renderer_copyshaders(shaders);
+  job->specializationInfo = (VkSpecializationInfo) { 0 };
+
+  if (specializationInfo) {
+    size_t mapEntriesSize = specializationInfo->mapEntryCount * sizeof(VkSpecializationMapEntry);
+    void *mapEntries = malloc(mapEntriesSize);
+    void *specializationData = malloc(specializationInfo->dataSize);
+    memcpy(mapEntries, specializationInfo->pMapEntries, mapEntriesSize);
+    memcpy(specializationData, specializationInfo->pData, specializationInfo->dataSize);
+
+    job->specializationInfo = (VkSpecializationInfo) {
+      .mapEntryCount = specializationInfo->mapEntryCount,
+      .pMapEntries = mapEntries,
+      .dataSize = specializationInfo->dataSize,
+      .pData = specializationData,
+    };
+  }
+
+  DATA(pipelineBuilder).pendingCount++;
+  ev_threadpool_submitbackground(ev_renderer_buildpipelinejob, job);
+
+  return new_handle;
+}
+
+// Swaps in the pipelines that finished compiling. The pipeline cache is
+// saved once everything that was requested is built, so that it survives
+// even if the application doesn't shut down cleanly.
+void ev_renderer_swapbuiltpipelines()
+{
+  PipelineBuilder *builder = &DATA(pipelineBuilder);
+
+  pthread_mutex_lock(&builder->mutex);
+
+  size_t readyCount = vec_len(builder->ready);
+  for (size_t i = 0; i < readyCount; i++) {
+    PipelineBuildJob *job = builder->ready[i];
+
+    if (job->generation == DATA(pipelineLibrary).generation) {
+      ev_renderer_allocatepipelinesets(&job->pipeline);
+
+      Pipeline *placeholder = &DATA(pipelineLibrary).store[job->handle];
+      vec_fini(placeholder->pSets);
+      *placeholder = job->pipeline;
+
+      if (placeholder->libraries[0]) {
+        ev_renderer_optimizepipeline(job->handle, placeholder);
+      }
+    }
+    // The library was cleared while the pipeline was compiling
+    else {
+      ev_vulkan_destroypipeline(job->pipeline.pipeline);
+      vec_fini(job->pipeline.pSets);
+    }
+
+    freePipelineBuildJob(job);
+    builder->pendingCount--;
+  }
+  vec_clear(builder->ready);
+
+  pthread_mutex_unlock(&builder->mutex);
+
+  if (readyCount > 0 && builder->pendingCount == 0) {
+    ev_pipelinecache_save();
+  }
+}
+
+// `specializationInfo` may be NULL, the shaders then use the defaults of
+// their specialization constants. Only DEFAULTPIPELINE, which is the
+// fallback of every other pipeline, is compiled before returning.
+PipelineHandle ev_renderer_registerPipeline(CONST_STR pipelineName, vec(Shader) *shaders, const VkSpecializationInfo *specializationInfo)
+{
+  PipelineHandle *handle = Hashmap(evstring, PipelineHandle).get(DATA(pipelineLibrary).map, pipelineName);
+
+  if (handle) {
+    return *handle;
+  }
+
+  PipelineHandle new_handle;
+  if (!strcmp(pipelineName, DEFAULTPIPELINE)) {
+    Pipeline newPipeline;
+    ev_renderer_buildpipeline(*shaders, specializationInfo, &newPipeline);
+    new_handle = ev_renderer_addpipeline(&newPipeline);
+    DATA(pipelineLibrary).fallback = new_handle;
+  }
+  else {
+    new_handle = ev_renderer_buildpipelineasync(*shaders, specializationInfo);
+  }
+
+  ev_renderer_namepipeline(pipelineName, new_handle, *shaders);
+  return new_handle;
+}
+
+// Returns the variant of a named pipeline specialized on `materialFeatures`,
+// requesting it on first use. Pipelines whose stages don't declare the
+// features constant are their own variant.
+PipelineHandle ev_renderer_getpipelinevariant(PipelineHandle base, uint32_t materialFeatures)
+{
+  for (size_t i = 0; i < vec_len(DATA(pipelineLibrary).variants); i++) {
+    PipelineVariant variant = DATA(pipelineLibrary).variants[i];
+    if (variant.base == base && variant.materialFeatures == materialFeatures) {
+      return variant.handle;
+    }
+  }
+
+  PipelineSource *source = NULL;
+  for (size_t i = 0; i < vec_len(DATA(pipelineLibrary).sources) && !source; i++) {
+    if (DATA(pipelineLibrary).sources[i].handle == base)
+      source = &DATA(pipelineLibrary).sources[i];
+  }
+
+  if (!source) {
+    return base;
+  }
+
+  // Shaders that don't read the features would compile to the same pipeline
+  bool specialized = false;
+  for (size_t i = 0; i < vec_len(source->shaders) && !specialized; i++) {
+    specialized = ev_shadercache_get(source->shaders[i])->specializationConstants & (1ull << MATERIAL_FEATURES_CONSTANT_ID);
+  }
+
+  if (!specialized) {
+    PipelineVariant variant = {
+      .base = base,
+      .materialFeatures = materialFeatures,
+      .handle = base,
+    };
+    vec_push(&DATA(pipelineLibrary).variants, &variant);
+    return base;
+  }
+
+  VkSpecializationMapEntry mapEntry = {
+    .constantID = MATERIAL_FEATURES_CONSTANT_ID,
+    .offset = 0,
+    .size = sizeof(uint32_t),
+  };
+  VkSpecializationInfo specializationInfo = {
+    .mapEntryCount = 1,
+    .pMapEntries = &mapEntry,
+    .dataSize = sizeof(uint32_t),
+    .pData = &materialFeatures,
+  };
+
+  PipelineVariant variant = {
+    .base = base,
+    .materialFeatures = materialFeatures,
+    .handle = ev_renderer_buildpipelineasync(source->shaders, &specializationInfo),
+  };
+  vec_push(&DATA(pipelineLibrary).variants, &variant);
+
+  return variant.handle;
+}
+
+// Set and pipeline layouts belong to the layout cache
 void destroyPipeline(Pipeline *pipeline)
 {
   ev_vulkan_destroypipeline(pipeline->pipeline);
-  ev_vulkan_destroypipelinelayout(pipeline->pipelineLayout);
 }
 
+void pipelineBuilderInit(PipelineBuilder *builder)
+{
+  pthread_mutex_init(&builder->mutex, NULL);
+  builder->ready = vec_init(PipelineBuildJob*);
+  builder->pendingCount = 0;
+}
+
+void pipelineBuilderDestroy(PipelineBuilder *builder)
+{
+  // Workers are joined and the device is idle at this point
+  for (size_t i = 0; i < vec_len(builder->ready); i++) {
+    ev_vulkan_destroypipeline(builder->ready[i]->pipeline.pipeline);
+    vec_fini(builder->ready[i]->pipeline.pSets);
+    freePipelineBuildJob(builder->ready[i]);
+  }
+  vec_fini(builder->ready);
+
+  pthread_mutex_destroy(&builder->mutex);
+}
+
+void pipelineOptimizerInit(PipelineOptimizer *optimizer)
+{
+  pthread_mutex_init(&optimizer->mutex, NULL);
+  optimizer->ready = vec_init(PipelineOptimizeJob*);
+  optimizer->retired = vec_init(RetiredPipeline);
+}
+
+void pipelineOptimizerDestroy(PipelineOptimizer *optimizer)
+{
+  // Workers are joined and the device is idle at this point
+  for (size_t i = 0; i < vec_len(optimizer->ready); i++) {
+    ev_vulkan_destroypipeline(optimizer->ready[i]->optimized);
+    free(optimizer->ready[i]);
+  }
+  vec_fini(optimizer->ready);
+
+  for (size_t i = 0; i < vec_len(optimizer->retired); i++) {
+    ev_vulkan_destroypipeline(optimizer->retired[i].pipeline);
+  }
+  vec_fini(optimizer->retired);
+
+  pthread_mutex_destroy(&optimizer->mutex);
+}
+
+void meshStreamerInit(MeshStreamer *streamer)
+{
+  pthread_mutex_init(&streamer->mutex, NULL);
+  streamer->ready = vec_init(MeshLoadJob*);
+}
+
+void meshStreamerDestroy(MeshStreamer *streamer)
+{
+  // Workers are joined at this point, drop whatever didn't get uploaded
+  for (size_t i = 0; i < vec_len(streamer->ready); i++) {
+    Asset->free(streamer->ready[i]->assetHandle);
+    evstring_free(streamer->ready[i]->path);
+    free(streamer->ready[i]);
+  }
+  vec_fini(streamer->ready);
+  pthread_mutex_destroy(&streamer->mutex);
+}
+
+// Key of a payload's content hash in the libraries' hash maps
+evstring ev_renderer_contenthashkey(uint64_t contentHash)
+{
+  return evstring_newfmt("%016llx", (unsigned long long)contentHash);
+}
+
+uint64_t ev_renderer_getdeduplicatedbytes()
+{
+  return DATA(deduplicatedBytes);
+}
+
+// Uploads a decoded mesh and patches it into its library entry. Must run on
+// the render thread.
+void ev_renderer_uploadmesh(MeshHandle handle, MeshAsset *meshAsset)
+{
+  uint64_t contentHash = ev_contenthash_compute(meshAsset->indexData, meshAsset->indexBuferSize,
+      ev_contenthash_compute(meshAsset->vertexData, meshAsset->vertexBuferSize, meshAsset->vertexCount));
+
+  evstring hashKey = ev_renderer_contenthashkey(contentHash);
+  MeshHandle *duplicate = Hashmap(evstring, MeshHandle).get(DATA(meshLibrary).hashes, hashKey);
+  if (duplicate) {
+    evstring_free(hashKey);
+    // Draws of both handles go through the same geometry ranges
+    RendererData.meshLibrary.store[handle] = RendererData.meshLibrary.store[*duplicate];
+    DATA(deduplicatedBytes) += meshAsset->vertexBuferSize + meshAsset->indexBuferSize;
+    return;
+  }
+
+  Mesh newMesh;
+
+  newMesh.indexCount = meshAsset->indexCount;
+  newMesh.vertexCount = meshAsset->vertexCount;
+
+  uint32_t vertexSize = meshAsset->vertexBuferSize / meshAsset->vertexCount;
+  DEBUG_ASSERT(meshAsset->indexBuferSize == meshAsset->indexCount * sizeof(uint32_t));
+
+  GeometryRange vertexRange;
+  GeometryRange indexRange;
+  bool newPage = ev_geometrybuffer_allocate(&DATA(vertexGeometry), vertexSize, meshAsset->vertexCount, &vertexRange);
+  newPage |= ev_geometrybuffer_allocate(&DATA(indexGeometry), sizeof(uint32_t), meshAsset->indexCount, &indexRange);
+
+  ev_uploadmanager_uploadbuffer(meshAsset->vertexData, meshAsset->vertexBuferSize,
+      ev_geometrybuffer_getpage(&DATA(vertexGeometry), vertexRange.pageIndex),
+      (unsigned long long)vertexRange.elementOffset * vertexSize);
+
+  // Indices get rebased on the mesh's vertex range, so shaders keep indexing
+  // the vertex page with them as they are.
+  StagingRegion indexStaging;
+  ev_uploadmanager_stage(meshAsset->indexBuferSize, 0, &indexStaging);
+
+  const uint32_t *srcIndices = (const uint32_t *)meshAsset->indexData;
+  uint32_t *dstIndices = (uint32_t *)indexStaging.mappedData;
+  for (uint32_t i = 0; i < meshAsset->indexCount; i++) {
+    dstIndices[i] = srcIndices[i] + vertexRange.elementOffset;
+  }
+
+  ev_uploadmanager_copybuffer(&indexStaging,
+      ev_geometrybuffer_getpage(&DATA(indexGeometry), indexRange.pageIndex),
+      (unsigned long long)indexRange.elementOffset * sizeof(uint32_t));
+
+  newMesh.indexBufferIndex  = indexRange.pageIndex;
+  newMesh.indexOffset       = indexRange.elementOffset;
+  newMesh.vertexBufferIndex = vertexRange.pageIndex;
+  newMesh.vertexOffset      = vertexRange.elementOffset;
+
+  RendererData.meshLibrary.store[handle] = newMesh;
+
+  Hashmap(evstring, MeshHandle).push(DATA(meshLibrary).hashes, hashKey, handle);
+
+  // Only new pages need to be bound, existing ones are already in the set.
+  // With buffer device address, shaders never go through the set at all.
+  if (newPage && !ev_vulkan_hasbufferdeviceaddress()) {
+    RendererData.meshLibrary.dirty = true;
+  }
+}
+
+void ev_renderer_loadmeshjob(void *data)
+{
+  MeshLoadJob *job = data;
+
+  job->assetHandle = Asset->load(job->path);
+  job->asset = MeshLoader->loadAsset(job->assetHandle);
+
+  pthread_mutex_lock(&DATA(meshStreamer).mutex);
+  vec_push(&DATA(meshStreamer).ready, &job);
+  pthread_mutex_unlock(&DATA(meshStreamer).mutex);
+}
+
+// Uploads the meshes that finished loading, up to `mesh_upload_budget` bytes
+// per frame. At least one mesh goes through every frame so that a mesh bigger
+// than the budget still makes it.
+void ev_renderer_streammeshes()
+{
+  unsigned long long uploadedBytes = 0;
+
+  pthread_mutex_lock(&DATA(meshStreamer).mutex);
+
+  size_t readyCount = vec_len(DATA(meshStreamer).ready);
+  size_t uploadedCount = 0;
+  for (; uploadedCount < readyCount; uploadedCount++)
+  {
+    MeshLoadJob *job = DATA(meshStreamer).ready[uploadedCount];
+    unsigned long long meshBytes = job->asset.vertexBuferSize + job->asset.indexBuferSize;
+
+    if (uploadedBytes > 0 && uploadedBytes + meshBytes > (unsigned long long)mesh_upload_budget)
+      break;
+
+    // Failed or empty loads keep their placeholder, which draws nothing
+    if (job->asset.vertexCount == 0 || job->asset.indexCount == 0) {
+      ev_log_error("Mesh %s has no geometry, keeping its empty placeholder", job->path);
+    } else {
+      ev_renderer_uploadmesh(job->handle, &job->asset);
+      uploadedBytes += meshBytes;
+    }
+
+    // The geometry is in the staging ring by now
+    Asset->free(job->assetHandle);
+    evstring_free(job->path);
+    free(job);
+  }
+
+  if (uploadedCount > 0)
+  {
+    memmove(DATA(meshStreamer).ready, DATA(meshStreamer).ready + uploadedCount, (readyCount - uploadedCount) * sizeof(MeshLoadJob*));
+    vec_setlen(&DATA(meshStreamer).ready, readyCount - uploadedCount);
+  }
+
+  pthread_mutex_unlock(&DATA(meshStreamer).mutex);
+}
+
+// Returns right away. Until the mesh is loaded and uploaded in the background
+// its library entry is an empty placeholder that draws nothing.
 MeshHandle ev_renderer_registerMesh(CONST_STR meshPath)
 {
   MeshHandle *handle = Hashmap(evstring, MeshHandle).get(DATA(meshLibrary).map, meshPath);
@@ -1761,83 +2543,367 @@ MeshHandle ev_renderer_registerMesh(CONST_STR meshPath)
     return *handle;
   }
 
-  Mesh newMesh;
-
   ev_log_debug("New mesh!: %s", meshPath);
-  AssetHandle mesh_handle = Asset->load(meshPath);
-  MeshAsset meshAsset = MeshLoader->loadAsset(mesh_handle);
 
-  newMesh.indexCount = meshAsset.indexCount;
-  newMesh.vertexCount = meshAsset.vertexCount;
+  Mesh placeholderMesh = { 0 };
+  MeshHandle new_handle = (MeshHandle)vec_push(&RendererData.meshLibrary.store, &placeholderMesh);
+  Hashmap(evstring, MeshHandle).push(DATA(meshLibrary).map, evstring_new(meshPath), new_handle);
+
+  MeshLoadJob *job = malloc(sizeof(MeshLoadJob));
+  job->handle = new_handle;
+  job->path = evstring_new(meshPath);
+  ev_threadpool_submit(ev_renderer_loadmeshjob, job);
 
-  EvBuffer indexBuffer  = ev_vulkan_registerbuffer(meshAsset.indexData, meshAsset.indexBuferSize);
-  EvBuffer vertexBuffer = ev_vulkan_registerbuffer(meshAsset.vertexData, meshAsset.vertexBuferSize);
+  return new_handle;
+}
 
-  newMesh.indexBufferIndex  = vec_push(&DATA(indexBuffers),  &indexBuffer);
-  newMesh.vertexBufferIndex = vec_push(&DATA(vertexBuffers), &vertexBuffer);
+// Creates the gpu image of a texture holding every level from `firstMip` on
+EvTexture ev_renderer_createstreamedtexture(uint32_t textureIndex, uint32_t firstMip)
+{
+  TextureLevels levels;
+  ev_texturestreamer_getlevels(textureIndex, firstMip, &levels);
 
-  MeshHandle new_handle = (MeshHandle)vec_push(&RendererData.meshLibrary.store, &newMesh);
-  Hashmap(evstring, MeshHandle).push(DATA(meshLibrary).map, evstring_new(meshPath), new_handle);
+  return ev_vulkan_registerTextureMips(levels.format, levels.width, levels.height, levels.mipCount, levels.pixels);
+}
+
+// Must be called once the fence of `frameNumber` is signaled. Replaced images
+// are only published into the resources set copy of that frame slot, the
+// other copies follow when their own fence is signaled. Frames in flight keep
+// sampling the old image, which is destroyed once none of them can use it.
+void ev_renderer_streamtextures(uint32_t frameNumber)
+{
+  uint32_t frameBit = 1u << frameNumber;
+
+  size_t pendingCount = 0;
+  for (size_t i = 0; i < vec_len(DATA(pendingTextureSlots)); i++) {
+    PendingTextureSlot *pending = &DATA(pendingTextureSlots)[i];
+    if (pending->frameMask & frameBit) {
+      ev_descriptorwriter_write(&DATA(descriptorWriter), frameNumber, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, DATA(resourcesSet), &DATA(resourcesSet).pBindings[4], pending->textureIndex, &(DATA(textureBuffers)[pending->textureIndex]));
+      pending->frameMask &= ~frameBit;
+    }
+
+    if (pending->frameMask) {
+      DATA(pendingTextureSlots)[pendingCount++] = *pending;
+    }
+  }
+  vec_setlen(&DATA(pendingTextureSlots), pendingCount);
+
+  size_t retiredCount = 0;
+  for (size_t i = 0; i < vec_len(DATA(retiredTextures)); i++) {
+    if (RendererData.frameNumber >= DATA(retiredTextures)[i].frameNumber + framebuffering_degree) {
+      ev_vulkan_destroytexture(&DATA(retiredTextures)[i].texture);
+    }
+    else {
+      DATA(retiredTextures)[retiredCount++] = DATA(retiredTextures)[i];
+    }
+  }
+  vec_setlen(&DATA(retiredTextures), retiredCount);
+
+  vec(TextureResidencyChange) changes = vec_init(TextureResidencyChange);
+  ev_texturestreamer_update(frameNumber, TEXTURESTREAMING_MAXPROMOTIONS, &changes);
+
+  uint32_t otherFrames = ((1u << framebuffering_degree) - 1) & ~frameBit;
+  for (size_t i = 0; i < vec_len(changes); i++) {
+    uint32_t textureIndex = changes[i].textureIndex;
+
+    vec_push(&DATA(retiredTextures), &(RetiredTexture) {
+      .texture = DATA(textureBuffers)[textureIndex],
+      .frameNumber = RendererData.frameNumber,
+    });
+    DATA(textureBuffers)[textureIndex] = ev_renderer_createstreamedtexture(textureIndex, changes[i].residentMip);
+
+    ev_descriptorwriter_write(&DATA(descriptorWriter), frameNumber, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, DATA(resourcesSet), &DATA(resourcesSet).pBindings[4], textureIndex, &(DATA(textureBuffers)[textureIndex]));
+
+    if (!otherFrames) {
+      continue;
+    }
+
+    // A texture that changes again before every copy caught up only needs
+    // its newest image published
+    size_t p = 0;
+    while (p < vec_len(DATA(pendingTextureSlots)) && DATA(pendingTextureSlots)[p].textureIndex != textureIndex)
+      p++;
+
+    if (p < vec_len(DATA(pendingTextureSlots))) {
+      DATA(pendingTextureSlots)[p].frameMask = otherFrames;
+    }
+    else {
+      vec_push(&DATA(pendingTextureSlots), &(PendingTextureSlot) {
+        .textureIndex = textureIndex,
+        .frameMask = otherFrames,
+      });
+    }
+  }
+
+  ev_descriptorwriter_flush(&DATA(descriptorWriter));
+  if (vec_len(changes)) {
+    ev_uploadmanager_flush();
+  }
+
+  vec_fini(changes);
+}
+
+// Single and two channel images are data (roughness, masks...) and always
+// linear, color images are sRGB unless they hold data like normal maps.
+VkFormat ev_renderer_gettextureformat(uint32_t channelCount, bool srgb)
+{
+  switch (channelCount) {
+    case 1:
+      return VK_FORMAT_R8_UNORM;
+    case 2:
+      return VK_FORMAT_R8G8_UNORM;
+    case 3:
+    case 4:
+      return srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+    default:
+      return VK_FORMAT_UNDEFINED;
+  }
+}
+
+// Textures only alias each other when they would end up as the same image
+uint64_t ev_renderer_hashtexture(VkFormat format, uint32_t width, uint32_t height, const void *pixels, unsigned long long size)
+{
+  uint32_t description[3] = { format, width, height };
+  return ev_contenthash_compute(pixels, size, ev_contenthash_compute(description, sizeof(description), 0));
+}
+
+typedef struct {
+  VkFormat format;
+  uint32_t width;
+  uint32_t height;
+  uint32_t channelCount;
+  unsigned long long bufferSize;
+  void *pixels;
+  uint64_t contentHash;
+  bool srgb;
+  // Only built when streaming is enabled, NULL pixels otherwise
+  TextureMipChain mipChain;
+} DecodedTexture;
+
+// The same file can be used as color and as data, each gets its own texture
+static evstring ev_renderer_texturekey(CONST_STR imagePath, bool srgb)
+{
+  return evstring_newfmt("%s:%s", imagePath, srgb ? "srgb" : "linear");
+}
+
+// Decoded images are tightly packed 8 bit channels
+static uint32_t ev_renderer_getimagechannelcount(const ImageAsset *image)
+{
+  switch (image->format) {
+    case EV_IMAGEFORMAT_R8G8B8_SRGB:
+      return 3;
+    default:
+      // Formats this module doesn't name yet, only trusted when the size matches exactly
+      if (image->width == 0 || image->height == 0 || image->bufferSize % ((uint64_t)image->width * image->height))
+        return 0;
+      return image->bufferSize / ((uint64_t)image->width * image->height);
+  }
+}
+
+// Loads, decodes and hashes an image, and builds its mip chain when streaming
+// is enabled. Touches no renderer state, so it is safe to run on the worker
+// threads.
+void ev_renderer_decodetexture(CONST_STR imagePath, bool srgb, DecodedTexture *texture)
+{
+  if (!strcmp(imagePath, DEFAULTEXTURE)) {
+    // default 2x2 texture
+    static uint32_t defaultPixels[4] = {~0, ~0, ~0, ~0};
+    texture->bufferSize = sizeof(defaultPixels);
+    texture->width = 2;
+    texture->height = 2;
+    texture->channelCount = 4;
+    texture->pixels = defaultPixels;
+  }
+  else
+  {
+    AssetHandle image_handle = Asset->load(imagePath);
+    ImageAsset imageAsset = ImageLoader->loadAsset(image_handle);
+
+    texture->bufferSize = imageAsset.bufferSize;
+    texture->width = imageAsset.width;
+    texture->height = imageAsset.height;
+    texture->pixels = imageAsset.data;
+    texture->channelCount = ev_renderer_getimagechannelcount(&imageAsset);
+
+    if (!imageAsset.data || imageAsset.width == 0 || imageAsset.height == 0 ||
+        imageAsset.bufferSize < (uint64_t)imageAsset.width * imageAsset.height * texture->channelCount) {
+      ev_log_error("Image %s failed to load or is empty", imagePath);
+      texture->channelCount = 0;
+    }
+  }
+
+  texture->srgb = srgb;
+  texture->format = ev_renderer_gettextureformat(texture->channelCount, srgb);
+  texture->contentHash = 0;
+  texture->mipChain.pixels = NULL;
+  if (texture->format != VK_FORMAT_UNDEFINED) {
+    texture->contentHash = ev_renderer_hashtexture(texture->format, texture->width, texture->height, texture->pixels,
+        (unsigned long long)texture->width * texture->height * texture->channelCount);
+
+    // The conversion and the mip chain are the expensive part of a streamed
+    // texture, they belong with the decode
+    if (ev_texturestreamer_isenabled()) {
+      ev_texturestreamer_buildmipchain(texture->format, texture->width, texture->height, texture->channelCount, texture->pixels, &texture->mipChain);
+    }
+  }
+}
+
+// Creates the gpu side of a decoded texture and adds it to the library.
+// Must run on the render thread, as it hands out the bindless slots.
+TextureHandle ev_renderer_registerdecodedtexture(CONST_STR imagePath, DecodedTexture *decoded)
+{
+  if (decoded->format == VK_FORMAT_UNDEFINED) {
+    ev_log_error("Texture %s couldn't be decoded or has an unsupported channel count (%u), falling back to the default texture", imagePath, decoded->channelCount);
+    return ev_renderer_registerTexture(DEFAULTEXTURE, true);
+  }
+
+  evstring hashKey = ev_renderer_contenthashkey(decoded->contentHash);
+  TextureHandle *duplicate = Hashmap(evstring, TextureHandle).get(DATA(textureLibrary).hashes, hashKey);
+  if (duplicate) {
+    evstring_free(hashKey);
+    ev_log_debug("%s is identical to texture #%llu", imagePath, (unsigned long long)*duplicate);
+    Hashmap(evstring, TextureHandle).push(DATA(textureLibrary).map, ev_renderer_texturekey(imagePath, decoded->srgb), *duplicate);
+    DATA(deduplicatedBytes) += decoded->bufferSize;
+    free(decoded->mipChain.pixels);
+    return *duplicate;
+  }
+
+  Texture newTexture = {
+    .bufferSize = decoded->bufferSize,
+    .width = decoded->width,
+    .height = decoded->height,
+  };
+
+  EvTexture textureBuffer;
+  uint32_t textureIndex = vec_len(DATA(textureBuffers));
+
+  if (ev_texturestreamer_isenabled()) {
+    // Only the mip tail goes to the gpu, the rest is streamed in on demand
+    uint32_t residentMip = ev_texturestreamer_register(textureIndex, &decoded->mipChain);
+    textureBuffer = ev_renderer_createstreamedtexture(textureIndex, residentMip);
+  } else {
+    textureBuffer = ev_vulkan_registerTexture(decoded->format, decoded->width, decoded->height, decoded->channelCount, decoded->pixels);
+  }
+  vec_push(&DATA(textureBuffers),  &textureBuffer);
 
-  RendererData.meshLibrary.dirty = true;
+  TextureHandle new_handle = (TextureHandle)vec_push(&RendererData.textureLibrary.store, &newTexture);
 
+  Hashmap(evstring, TextureHandle).push(DATA(textureLibrary).map, ev_renderer_texturekey(imagePath, decoded->srgb), new_handle);
+  Hashmap(evstring, TextureHandle).push(DATA(textureLibrary).hashes, hashKey, new_handle);
+  RendererData.textureLibrary.dirty = true;
+  DEBUG_ASSERT(textureIndex == new_handle);
   return new_handle;
 }
 
-TextureHandle ev_renderer_registerTexture(CONST_STR imagePath)
+TextureHandle ev_renderer_registerTexture(CONST_STR imagePath, bool srgb)
 {
   ev_log_debug("%s", imagePath);
-  TextureHandle *handle = Hashmap(evstring, TextureHandle).get(DATA(textureLibrary).map, imagePath);
+  evstring key = ev_renderer_texturekey(imagePath, srgb);
+  TextureHandle *handle = Hashmap(evstring, TextureHandle).get(DATA(textureLibrary).map, key);
+  evstring_free(key);
 
   if (handle) {
     ev_log_debug("found image in library!");
     return *handle;
   }
 
-  Texture newTexture;
+  DecodedTexture decoded;
+  ev_renderer_decodetexture(imagePath, srgb, &decoded);
+  return ev_renderer_registerdecodedtexture(imagePath, &decoded);
+}
 
-  VkFormat format;
-  EvTexture textureBuffer;
-  uint32_t textureIndex;
-  TextureHandle new_handle;
+typedef struct {
+  evstring path;
+  bool srgb;
+  DecodedTexture texture;
+} TextureDecodeJob;
 
-  if (!strcmp(imagePath, DEFAULTEXTURE)) {
-    // default 2x2 texture
-    format = VK_FORMAT_R8G8B8A8_SRGB;
+void ev_renderer_decodetexturejob(void *data)
+{
+  TextureDecodeJob *job = data;
+  ev_renderer_decodetexture(job->path, job->srgb, &job->texture);
+}
 
-    uint32_t pixels[4] = {~0, ~0, ~0, ~0};
-    newTexture.bufferSize = sizeof(pixels);
-    newTexture.width = 2;
-    newTexture.height = 2;
+// Whichever color space a material asks for, it gets the container's format
+static void ev_renderer_pushcompressedtexturekeys(CONST_STR name, TextureHandle handle)
+{
+  Hashmap(evstring, TextureHandle).push(DATA(textureLibrary).map, ev_renderer_texturekey(name, true), handle);
+  Hashmap(evstring, TextureHandle).push(DATA(textureLibrary).map, ev_renderer_texturekey(name, false), handle);
+}
 
-    textureBuffer = ev_vulkan_registerTexture(format, 2, 2, pixels);
-    textureIndex = vec_push(&DATA(textureBuffers),  &textureBuffer);
+// Registers a KTX2 container under `name`, materials can then reference it
+// like any other texture path. Block compressed textures are uploaded with
+// the levels they ship with and are never streamed.
+TextureHandle ev_renderer_registerCompressedTexture(CONST_STR name, PTR data, uint64_t size)
+{
+  // The container decides the format, both keys are always pushed together
+  evstring key = ev_renderer_texturekey(name, true);
+  TextureHandle *handle = Hashmap(evstring, TextureHandle).get(DATA(textureLibrary).map, key);
+  evstring_free(key);
 
-    new_handle = (TextureHandle)vec_push(&RendererData.textureLibrary.store, &newTexture);
+  if (handle) {
+    return *handle;
   }
-  else
-  {
-    AssetHandle image_handle = Asset->load(imagePath);
-    ImageAsset imageAsset = ImageLoader->loadAsset(image_handle);
 
-    switch (imageAsset.format) {
-      case EV_IMAGEFORMAT_R8G8B8_SRGB:
-        format = VK_FORMAT_R8G8B8A8_SRGB;
-    }
+  KTX2Texture ktx2;
+  if (!ev_ktx2_parse(data, size, &ktx2)) {
+    ev_log_error("Couldn't load compressed texture %s, falling back to the default texture", name);
+    return ev_renderer_registerTexture(DEFAULTEXTURE, true);
+  }
 
-    format = VK_FORMAT_R8G8B8A8_SRGB;
+  if (!ev_vulkan_issampledformatsupported(ktx2.format)) {
+    ev_log_error("Texture %s uses a format (%d) that the device can't sample, falling back to the default texture", name, ktx2.format);
+    return ev_renderer_registerTexture(DEFAULTEXTURE, true);
+  }
 
-    newTexture.bufferSize = imageAsset.bufferSize;
-    newTexture.width = imageAsset.width;
-    newTexture.height = imageAsset.height;
+  // The container already describes the format and every level
+  uint64_t contentHash = ev_contenthash_compute(data, size, 0);
+  evstring hashKey = ev_renderer_contenthashkey(contentHash);
+  TextureHandle *duplicate = Hashmap(evstring, TextureHandle).get(DATA(textureLibrary).hashes, hashKey);
+  if (duplicate) {
+    evstring_free(hashKey);
+    ev_renderer_pushcompressedtexturekeys(name, *duplicate);
+    DATA(deduplicatedBytes) += size;
+    return *duplicate;
+  }
 
-    textureBuffer = ev_vulkan_registerTexture(format, imageAsset.width, imageAsset.height, imageAsset.data);
-    textureIndex = vec_push(&DATA(textureBuffers),  &textureBuffer);
+  Texture newTexture = {
+    .bufferSize = 0,
+    .width = ktx2.width,
+    .height = ktx2.height,
+  };
 
-    new_handle = (TextureHandle)vec_push(&RendererData.textureLibrary.store, &newTexture);
+  EvTexture textureBuffer;
+  uint32_t textureIndex = vec_len(DATA(textureBuffers));
+
+  bool uncompressed = ktx2.format == VK_FORMAT_R8G8B8A8_SRGB || ktx2.format == VK_FORMAT_R8G8B8A8_UNORM;
+  if (ktx2.levelCount == 0 && uncompressed) {
+    // The parser already checked that the base level covers its extent
+    DEBUG_ASSERT(ktx2.levelSizes[0] == (unsigned long long)ktx2.width * ktx2.height * 4);
+    newTexture.bufferSize = ktx2.levelSizes[0];
+    textureBuffer = ev_vulkan_registerTexture(ktx2.format, ktx2.width, ktx2.height, 4, ktx2.levels[0]);
+  } else {
+    // Compressed containers that ask for generated mips only get their base
+    // level, blits can't produce block compressed levels
+    uint32_t levelCount = MAX(ktx2.levelCount, 1);
+    if (!uncompressed && levelCount == 1 && ev_vulkan_getmipcount(ktx2.width, ktx2.height) > 1) {
+      ev_log_warn("Compressed texture %s has no mip chain and will alias when minified, ship its levels in the container", name);
+    }
+    for (uint32_t i = 0; i < levelCount; i++) {
+      newTexture.bufferSize += ktx2.levelSizes[i];
+    }
+    textureBuffer = ev_vulkan_registerTextureLevels(ktx2.format, ktx2.width, ktx2.height, levelCount, ktx2.levels, ktx2.levelSizes);
   }
 
-  Hashmap(evstring, TextureHandle).push(DATA(textureLibrary).map, evstring_new(imagePath), new_handle);
+  if (ev_texturestreamer_isenabled()) {
+    ev_texturestreamer_registerresident(textureIndex);
+  }
+
+  vec_push(&DATA(textureBuffers),  &textureBuffer);
+  TextureHandle new_handle = (TextureHandle)vec_push(&RendererData.textureLibrary.store, &newTexture);
+
+  ev_renderer_pushcompressedtexturekeys(name, new_handle);
+  Hashmap(evstring, TextureHandle).push(DATA(textureLibrary).hashes, hashKey, new_handle);
   RendererData.textureLibrary.dirty = true;
   DEBUG_ASSERT(textureIndex == new_handle);
   return new_handle;
@@ -1898,8 +2964,7 @@ RenderComponent ev_renderer_registerRenderComponent(const char *meshPath, const
   newComponent.materialIndex = ev_renderer_getMaterial(materialName);
   newComponent.pipelineIndex = RendererData.materialLibrary.pipelineHandles[newComponent.materialIndex];
 
-  uint32_t meshID = ev_renderer_registerMesh(meshPath);
-  newComponent.mesh = *(RendererData.meshLibrary.store + meshID);
+  newComponent.meshIndex = ev_renderer_registerMesh(meshPath);
 
   return newComponent;
 }
@@ -1922,12 +2987,81 @@ LightComponent ev_renderer_registerLightomponent(evjson_t *json_context, evjson_
   return newComponent;
 }
 
+// Texture slots of a material and whether they hold color data
+static const struct {
+  const char *name;
+  bool srgb;
+} MaterialTextureSlots[] = {
+  { "albedoTexture",            true  },
+  { "normalTexture",            false },
+  { "metallicRoughnessTexture", false },
+  { "emissiveTexture",          true  },
+};
+
+// Decodes every texture the material list references that isn't in the
+// library yet on the thread pool, then registers them in list order. The
+// materials then find their textures in the library.
+void ev_material_prefetchtextures(evjson_t *json_context, const char *list_name, int material_count)
+{
+  Map(evstring, TextureHandle) pending = Hashmap(evstring, TextureHandle).new();
+  vec(TextureDecodeJob) jobs = vec_init(TextureDecodeJob);
+
+  for(int i = 0; i < material_count; i++)
+  {
+    for (size_t slot = 0; slot < ARRAYSIZE(MaterialTextureSlots); slot++)
+    {
+      evstring texture_jsonid = evstring_newfmt("%s[%d].%s", list_name, i, MaterialTextureSlots[slot].name);
+      evjson_entry *textureEntry = evjs_get(json_context, texture_jsonid);
+      evstring_free(texture_jsonid);
+
+      if (!textureEntry) {
+        continue;
+      }
+
+      evstring key = ev_renderer_texturekey(textureEntry->as_str, MaterialTextureSlots[slot].srgb);
+      if (Hashmap(evstring, TextureHandle).get(DATA(textureLibrary).map, key) ||
+          Hashmap(evstring, TextureHandle).get(pending, key)) {
+        evstring_free(key);
+        continue;
+      }
+
+      TextureDecodeJob job = {
+        .path = evstring_refclone(textureEntry->as_str),
+        .srgb = MaterialTextureSlots[slot].srgb,
+      };
+      TextureHandle jobIndex = (TextureHandle)vec_push(&jobs, &job);
+      Hashmap(evstring, TextureHandle).push(pending, key, jobIndex);
+    }
+  }
+
+  // The vector doesn't grow past this point, so the jobs can point into it
+  // Only this batch is waited on, not the mesh loads or pipeline links queued
+  // by others
+  ThreadPoolGroup decodeGroup = {0};
+  for (size_t i = 0; i < vec_len(jobs); i++) {
+    ev_threadpool_submitgroup(&decodeGroup, ev_renderer_decodetexturejob, &jobs[i]);
+  }
+  ev_threadpool_waitgroup(&decodeGroup);
+
+  // Registration stays serial to keep bindless slots in a deterministic order.
+  // The copies are only recorded here and go out with the next upload flush.
+  for (size_t i = 0; i < vec_len(jobs); i++) {
+    ev_renderer_registerdecodedtexture(jobs[i].path, &jobs[i].texture);
+    evstring_free(jobs[i].path);
+  }
+
+  vec_fini(jobs);
+  Hashmap(evstring, TextureHandle).free(pending);
+}
+
 void ev_material_readjsonlist(evjson_t *json_context, const char *list_name)
 {
   evstring materials = evstring_newfmt("%s.len", list_name);
   int material_count = (int)evjs_get(json_context , materials)->as_num;
   evstring_free(materials);
 
+  ev_material_prefetchtextures(json_context, list_name, material_count);
+
   for(int i = 0; i < material_count; i++)
   {
     Material newMaterial = {0};
@@ -1943,11 +3077,14 @@ void ev_material_readjsonlist(evjson_t *json_context, const char *list_name)
       evstring_free(material_basecolor);
     }
 
+    uint32_t materialFeatures = 0;
+
     evstring albedo_jsonid = evstring_newfmt("%s[%d].albedoTexture", list_name, i);
     evjson_entry *albedoEntry = evjs_get(json_context, albedo_jsonid);
     if (albedoEntry) {
       evstring albedo = evstring_refclone(albedoEntry->as_str);
-      newMaterial.albedoTexture = ev_renderer_registerTexture(albedo);
+      newMaterial.albedoTexture = ev_renderer_registerTexture(albedo, true);
+      materialFeatures |= MATERIAL_FEATURE_ALBEDO;
       evstring_free(albedo);
     }
     else {
@@ -1959,7 +3096,8 @@ void ev_material_readjsonlist(evjson_t *json_context, const char *list_name)
     evjson_entry *normalEntry = evjs_get(json_context, normal_jsonid);
     if (normalEntry) {
       evstring normal = evstring_refclone(normalEntry->as_str);
-      newMaterial.normalTexture = ev_renderer_registerTexture(normal);
+      newMaterial.normalTexture = ev_renderer_registerTexture(normal, false);
+      materialFeatures |= MATERIAL_FEATURE_NORMAL;
       evstring_free(normal);
     }
     else {
@@ -1991,7 +3129,8 @@ void ev_material_readjsonlist(evjson_t *json_context, const char *list_name)
     evjson_entry *metallicRoughnessTextureEntry = evjs_get(json_context, metallicRoughnessTexture_jsonid);
     if (metallicRoughnessTextureEntry) {
       evstring metallicRoughnessTexture = evstring_refclone(metallicRoughnessTextureEntry->as_str);
-      newMaterial.metallicRoughnessTexture = ev_renderer_registerTexture(metallicRoughnessTexture);
+      newMaterial.metallicRoughnessTexture = ev_renderer_registerTexture(metallicRoughnessTexture, false);
+      materialFeatures |= MATERIAL_FEATURE_METALLICROUGHNESS;
       evstring_free(metallicRoughnessTexture);
     }
     else {
@@ -2003,7 +3142,8 @@ void ev_material_readjsonlist(evjson_t *json_context, const char *list_name)
     evjson_entry *emissiveEntry = evjs_get(json_context, emissive_jsonid);
     if (emissiveEntry) {
       evstring emissive = evstring_refclone(emissiveEntry->as_str);
-      newMaterial.emissiveTexture = ev_renderer_registerTexture(emissive);
+      newMaterial.emissiveTexture = ev_renderer_registerTexture(emissive, true);
+      materialFeatures |= MATERIAL_FEATURE_EMISSIVE;
       evstring_free(emissive);
     }
     else {
@@ -2025,13 +3165,16 @@ void ev_material_readjsonlist(evjson_t *json_context, const char *list_name)
 
 // TODO fix this
     evstring materialPipeline_jsonid = evstring_newfmt("%s[%d].pipeline", list_name, i);
-    PipelineHandle materialPipelineHandle;
+    PipelineHandle materialPipelineHandle = INVALID_PIPELINE_HANDLE;
     if (evjs_get(json_context, materialPipeline_jsonid))
     {
       evstring materialPipeline = evstring_refclone(evjs_get(json_context, materialPipeline_jsonid)->as_str);
       materialPipelineHandle = ev_renderer_getPipeline(materialPipeline);
       evstring_free(materialPipeline);
     }
+    if (materialPipelineHandle != INVALID_PIPELINE_HANDLE) {
+      materialPipelineHandle = ev_renderer_getpipelinevariant(materialPipelineHandle, materialFeatures);
+    }
     // else {
     //   materialPipelineHandle = ev_renderer_getPipeline(DEFAULTPIPELINE);
     // }
@@ -2066,6 +3209,8 @@ ShaderAssetStage jsonshadertype_to_assetstage(evstr_ref type) {
   }
 }
 
+// Shaders are loaded while walking the list, the pipelines themselves are
+// compiled on the thread pool and then added to the library in list order.
 void ev_graphicspipeline_readjsonlist(evjson_t *json_context, const char *list_name)
 {
   vec(AssetHandle) loadedAssets = vec_init(AssetHandle);
@@ -2074,6 +3219,13 @@ void ev_graphicspipeline_readjsonlist(evjson_t *json_context, const char *list_n
   for(U32 i = 0; i < pipelineCount; i++) {
     evstring pipelineName_jsonid = evstring_newfmt("%s[%d].id", list_name, i);
     evstring pipelineName = evstring_refclone(evjs_get(json_context, pipelineName_jsonid)->as_str);
+
+    if (Hashmap(evstring, PipelineHandle).get(DATA(pipelineLibrary).map, pipelineName)) {
+      evstring_free(pipelineName_jsonid);
+      evstring_free(pipelineName);
+      continue;
+    }
+
     evstring shaderStages_jsonid = evstring_newfmt("%s[%d].shaderStages", list_name, i);
     evstring shaderStagesCount_jsonid = evstring_newfmt("%s.len", shaderStages_jsonid);
     U32 shaderStagesCount = (U32)evjs_get(json_context, shaderStagesCount_jsonid)->as_num;
@@ -2091,16 +3243,8 @@ void ev_graphicspipeline_readjsonlist(evjson_t *json_context, const char *list_n
       evstring shaderPath_jsonid = evstring_newfmt("%s.shaderPath", shaderStage_jsonid);
       evstring shaderPath = evstring_refclone(evjs_get(json_context, shaderPath_jsonid)->as_str);
 
-      AssetHandle asset = Asset->load(shaderPath);
-      vec_push(&loadedAssets, &asset);
-
-      ShaderAsset shaderAsset = ShaderLoader->loadAsset(asset, shaderAssetStage, shaderPath, NULL, EV_SHADER_BIN);
-
-      vec_push(&shaders, &(Shader){
-        .data = shaderAsset.binary,
-        .length = shaderAsset.len,
-        .stage = vkShaderStage,
-      });
+      Shader shader = ev_renderer_loadshader(shaderPath, shaderAssetStage, vkShaderStage, &loadedAssets);
+      vec_push(&shaders, &shader);
 
       evstring_free(shaderPath);
       evstring_free(shaderPath_jsonid);
@@ -2109,17 +3253,18 @@ void ev_graphicspipeline_readjsonlist(evjson_t *json_context, const char *list_n
       evstring_free(shaderStage_jsonid);
     }
 
-    ev_renderer_registerPipeline(pipelineName, &shaders);
-
+    // Only compiled in place for DEFAULTPIPELINE, the others build on the workers
+    ev_renderer_registerPipeline(pipelineName, &shaders, NULL);
     vec_fini(shaders);
+    evstring_free(pipelineName);
 
     evstring_free(shaderStagesCount_jsonid);
     evstring_free(shaderStages_jsonid);
 
     evstring_free(pipelineName_jsonid);
-    evstring_free(pipelineName);
   }
 
+  // Pipelines keep their own copy of the SPIR-V
   for(size_t asset_idx = 0; asset_idx < vec_len(loadedAssets); asset_idx++) {
     Asset->free(loadedAssets[asset_idx]);
   }
@@ -2180,21 +3325,36 @@ EV_CONSTRUCTOR
   RendererData.frameNumber = 0;
 
   RendererData.textureBuffers = vec_init(EvTexture, NULL, ev_vulkan_destroytexture);
-  RendererData.vertexBuffers  = vec_init(EvBuffer, NULL, ev_vulkan_destroybuffer);
-  RendererData.indexBuffers   = vec_init(EvBuffer, NULL, ev_vulkan_destroybuffer);
   RendererData.customBuffers  = vec_init(EvBuffer, NULL, ev_vulkan_destroybuffer);
+  ev_descriptorwriter_init(&DATA(descriptorWriter));
+  RendererData.pendingTextureSlots = vec_init(PendingTextureSlot);
+  RendererData.retiredTextures = vec_init(RetiredTexture);
 
+  ev_vulkan_requestbufferdeviceaddress(buffer_device_address);
+  ev_vulkan_requestsampleranisotropy(texture_anisotropy);
   ev_vulkan_init();
+  ev_pipelinecache_init(pipeline_cache_path);
+  ev_shaderarchive_open(SHADERARCHIVE_PATH);
+
+  ev_geometrybuffer_init(&DATA(vertexGeometry), GEOMETRYPAGESIZE);
+  ev_geometrybuffer_init(&DATA(indexGeometry), GEOMETRYPAGESIZE);
+  ev_texturestreamer_init(BINDLESSARRAYSIZE, texture_streaming_budget,
+      texture_streaming && ev_vulkan_getenabledfeatures()->fragmentStoresAndAtomics);
   ev_syncmanager_init();
 
   ev_renderer_globalsetsinit();
 
   materialLibraryInit(&DATA(materialLibrary));
   pipelineLibraryInit(&DATA(pipelineLibrary));
+  pipelineBuilderInit(&DATA(pipelineBuilder));
+  pipelineOptimizerInit(&DATA(pipelineOptimizer));
   textureLibraryInit(&(DATA(textureLibrary)));
   meshLibraryInit(&DATA(meshLibrary));
+  meshStreamerInit(&DATA(meshStreamer));
+
+  ev_threadpool_init(worker_thread_count);
 
-  ev_renderer_registerTexture(DEFAULTEXTURE);
+  ev_renderer_registerTexture(DEFAULTEXTURE, true);
 
   ev_syncmanager_allocatesemaphores(SWAPCHAIN_MAX_IMAGES, &DATA(offscreenRendering));
   ev_syncmanager_allocatesemaphores(SWAPCHAIN_MAX_IMAGES, &DATA(shadowmapRendering));
@@ -2214,46 +3374,52 @@ void ev_renderer_clear()
   Hashmap(evstring, MaterialHandle).clear(RendererData.materialLibrary.map);
   vec_clear(RendererData.materialLibrary.store);
   vec_clear(RendererData.materialLibrary.pipelineHandles);
+  RendererData.materialLibrary.uploadedCount = 0;
 
   Hashmap(evstring, PipelineHandle).clear(RendererData.pipelineLibrary.map);
   vec_clear(RendererData.pipelineLibrary.store);
+  vec_clear(RendererData.pipelineLibrary.sources);
+  vec_clear(RendererData.pipelineLibrary.variants);
+  RendererData.pipelineLibrary.fallback = INVALID_PIPELINE_HANDLE;
+  RendererData.pipelineLibrary.generation++;
 
   ev_renderpass_destory(RendererData.skyboxPass);
   ev_renderpass_destory(RendererData.lightPass);
   ev_renderpass_destory(RendererData.shadowmapPass);
   ev_renderpass_destory(RendererData.offscreenPass);
 
+  // Global set layouts used as overrides are destroyed in
+  // ev_renderer_globalsetsdinit, all other layouts by the layout cache
   destroyPipeline(&DATA(fxaaPipeline));
-  for (size_t i = 0; i < vec_len(DATA(fxaaPipeline).pSets); i++) {
-    ev_vulkan_destroysetlayout(DATA(fxaaPipeline).pSets[i].layout);
-  }
-
   destroyPipeline(&DATA(skyboxPipeline));
-  for (size_t i = 0; i < vec_len(DATA(skyboxPipeline).pSets); i++) {
-    ev_vulkan_destroysetlayout(DATA(skyboxPipeline).pSets[i].layout);
-  }
-
   destroyPipeline(&DATA(lightPipeline));
-  for (size_t i = 0; i < vec_len(DATA(lightPipeline).pSets); i++) {
-    ev_vulkan_destroysetlayout(DATA(lightPipeline).pSets[i].layout);
-  }
-
   destroyPipeline(&DATA(shadowmapPipeline));
-  for (size_t i = 0; i < vec_len(DATA(shadowmapPipeline).pSets); i++) {
-    ev_vulkan_destroysetlayout(DATA(shadowmapPipeline).pSets[i].layout);
-  }
 }
 
 EV_DESTRUCTOR
 {
+  ev_threadpool_deinit();
+  meshStreamerDestroy(&DATA(meshStreamer));
+
   ev_vulkan_wait();
+  ev_uploadmanager_waitidle();
 
   ev_renderer_clear();
+  pipelineBuilderDestroy(&DATA(pipelineBuilder));
+  pipelineOptimizerDestroy(&DATA(pipelineOptimizer));
 
   vec_fini(DATA(textureBuffers));
   vec_fini(DATA(customBuffers));
-  vec_fini(DATA(vertexBuffers));
-  vec_fini(DATA(indexBuffers));
+  ev_descriptorwriter_deinit(&DATA(descriptorWriter));
+
+  for (size_t i = 0; i < vec_len(DATA(retiredTextures)); i++) {
+    ev_vulkan_destroytexture(&DATA(retiredTextures)[i].texture);
+  }
+  vec_fini(DATA(retiredTextures));
+  vec_fini(DATA(pendingTextureSlots));
+
+  ev_geometrybuffer_deinit(&DATA(vertexGeometry));
+  ev_geometrybuffer_deinit(&DATA(indexGeometry));
 
   meshLibraryDestroy(DATA(meshLibrary));
   textureLibraryDestroy(DATA(textureLibrary));
@@ -2264,8 +3430,11 @@ EV_DESTRUCTOR
 
   ev_renderer_globalsetsdinit();
 
+  ev_texturestreamer_deinit();
   ev_syncmanager_deinit();
+  ev_pipelinecache_deinit();
   ev_vulkan_deinit();
+  ev_shaderarchive_close();
 
   FrameData_fini(&DATA(currentFrame));
 
@@ -2279,6 +3448,8 @@ EV_BINDINGS
   EV_NS_BIND_FN(Renderer, run, run);
   EV_NS_BIND_FN(Renderer, addFrameObjectData, ev_renderer_addFrameObjectData);
   EV_NS_BIND_FN(Renderer, registerComponent, ev_renderer_registerRenderComponent);
+  EV_NS_BIND_FN(Renderer, registerCompressedTexture, ev_renderer_registerCompressedTexture);
+  EV_NS_BIND_FN(Renderer, getDeduplicatedBytes, ev_renderer_getdeduplicatedbytes);
 
   EV_NS_BIND_FN(Material, readJSONList, ev_material_readjsonlist);
 
@@ -2293,6 +3464,8 @@ void materialLibraryInit(MaterialLibrary *library)
   library->map = Hashmap(evstring, MaterialHandle).new();
   library->store = vec_init(Material);
   library->pipelineHandles = vec_init(PipelineHandle);
+  library->uploadedCount = 0;
+  library->bufferCapacity = 0;
   library->dirty = false;
 }
 
@@ -2303,16 +3476,27 @@ void materialLibraryDestroy(MaterialLibrary library)
   vec_fini(library.pipelineHandles);
 }
 
+void destroyPipelineSource(PipelineSource *source)
+{
+  ev_renderer_freeshaders(source->shaders);
+}
+
 void pipelineLibraryInit(PipelineLibrary *library)
 {
   library->map = Hashmap(evstring, PipelineHandle).new();
   library->store = vec_init(Pipeline, NULL, destroyPipeline);
+  library->sources = vec_init(PipelineSource, NULL, destroyPipelineSource);
+  library->variants = vec_init(PipelineVariant);
+  library->fallback = INVALID_PIPELINE_HANDLE;
+  library->generation = 0;
   library->dirty = false;
 }
 
 void pipelineLibraryDestroy(PipelineLibrary library)
 {
   vec_fini(library.store);
+  vec_fini(library.sources);
+  vec_fini(library.variants);
   Hashmap(evstring, PipelineHandle).free(library.map);
 }
 
@@ -2320,6 +3504,9 @@ void meshLibraryInit(MeshLibrary *library)
 {
   library->map = Hashmap(evstring, MeshHandle).new();
   library->store = vec_init(Mesh);
+  library->hashes = Hashmap(evstring, MeshHandle).new();
+  library->boundVertexPages = 0;
+  library->boundIndexPages = 0;
   library->dirty = false;
 }
 
@@ -2327,12 +3514,15 @@ void meshLibraryDestroy(MeshLibrary library)
 {
   Hashmap(evstring, MeshHandle).free(library.map);
   vec_fini(library.store);
+  Hashmap(evstring, MeshHandle).free(library.hashes);
 }
 
 void textureLibraryInit(TextureLibrary *library)
 {
   library->map = Hashmap(evstring, TextureHandle).new();
   library->store = vec_init(Texture);
+  library->hashes = Hashmap(evstring, TextureHandle).new();
+  library->boundCount = 0;
   library->dirty = false;
 }
 
@@ -2340,4 +3530,5 @@ void textureLibraryDestroy(TextureLibrary library)
 {
   Hashmap(evstring, TextureHandle).free(library.map);
   vec_fini(library.store);
+  Hashmap(evstring, TextureHandle).free(library.hashes);
 }
@@ -0,0 +1,217 @@
+// evshaderpack: packs SPIR-V binaries and their reflection into a single
+// shader archive that the renderer maps at startup.
+//
+// Usage: evshaderpack <output> [name=]<shader.spv>...
+//
+// Without an explicit name, an entry is named after the file with its
+// `.spv` extension stripped, so `shadowmap.vert.spv` is found by the renderer
+// as `shaders://shadowmap.vert`.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <spvref/spirv_reflect.h>
+#include <ShaderArchive/ShaderArchive_format.h>
+
+typedef struct {
+  ShaderArchiveEntry entry;
+  void *code;
+  ShaderArchiveBinding *bindings;
+} PackedShader;
+
+static void *readfile(const char *path, size_t *size)
+{
+  FILE *file = fopen(path, "rb");
+  if (!file) {
+    return NULL;
+  }
+
+  fseek(file, 0, SEEK_END);
+  long length = ftell(file);
+  fseek(file, 0, SEEK_SET);
+
+  void *data = length > 0 ? malloc(length) : NULL;
+  if (data && fread(data, length, 1, file) != 1) {
+    free(data);
+    data = NULL;
+  }
+  fclose(file);
+
+  *size = data ? (size_t)length : 0;
+  return data;
+}
+
+static void nameentry(const char *arg, char *name, const char **path)
+{
+  const char *separator = strchr(arg, '=');
+  if (separator) {
+    snprintf(name, SHADERARCHIVE_MAX_NAME, "%.*s", (int)(separator - arg), arg);
+    *path = separator + 1;
+    return;
+  }
+
+  const char *base = arg;
+  for (const char *c = arg; *c; c++) {
+    if (*c == '/' || *c == '\\')
+      base = c + 1;
+  }
+  size_t length = strlen(base);
+  if (length > 4 && !strcmp(base + length - 4, ".spv"))
+    length -= 4;
+  snprintf(name, SHADERARCHIVE_MAX_NAME, "%.*s", (int)length, base);
+  *path = arg;
+}
+
+static int reflect(PackedShader *shader)
+{
+  SpvReflectShaderModule module;
+  if (spvReflectCreateShaderModule(shader->entry.codeSize, shader->code, &module) != SPV_REFLECT_RESULT_SUCCESS) {
+    return 0;
+  }
+
+  shader->entry.stage = module.shader_stage;
+
+  uint32_t setCount = 0;
+  spvReflectEnumerateDescriptorSets(&module, &setCount, NULL);
+  SpvReflectDescriptorSet **sets = calloc(setCount ? setCount : 1, sizeof(SpvReflectDescriptorSet*));
+  spvReflectEnumerateDescriptorSets(&module, &setCount, sets);
+
+  uint32_t bindingCount = 0;
+  for (uint32_t i = 0; i < setCount; i++)
+    bindingCount += sets[i]->binding_count;
+
+  shader->bindings = calloc(bindingCount ? bindingCount : 1, sizeof(ShaderArchiveBinding));
+  shader->entry.bindingCount = bindingCount;
+
+  // Grouped by set, the renderer relies on it
+  uint32_t bindingIndex = 0;
+  for (uint32_t i = 0; i < setCount; i++) {
+    for (uint32_t j = 0; j < sets[i]->binding_count; j++) {
+      const SpvReflectDescriptorBinding *binding = sets[i]->bindings[j];
+
+      uint32_t descriptorCount = 1;
+      for (uint32_t dim = 0; dim < binding->array.dims_count; dim++)
+        descriptorCount *= binding->array.dims[dim];
+
+      shader->bindings[bindingIndex++] = (ShaderArchiveBinding) {
+        .set = sets[i]->set,
+        .binding = binding->binding,
+        .descriptorType = binding->descriptor_type,
+        .descriptorCount = descriptorCount,
+      };
+    }
+  }
+  free(sets);
+
+  uint32_t pushConstantCount = 0;
+  spvReflectEnumeratePushConstants(&module, &pushConstantCount, NULL);
+  if (pushConstantCount > 0) {
+    SpvReflectBlockVariable **pushConstants = calloc(pushConstantCount, sizeof(SpvReflectBlockVariable*));
+    spvReflectEnumeratePushConstants(&module, &pushConstantCount, pushConstants);
+    shader->entry.pushConstantOffset = pushConstants[0]->offset;
+    shader->entry.pushConstantSize = pushConstants[0]->size;
+    free(pushConstants);
+  }
+
+  spvReflectDestroyShaderModule(&module);
+  return 1;
+}
+
+static int compareshaders(const void *a, const void *b)
+{
+  return strcmp(((const PackedShader*)a)->entry.name, ((const PackedShader*)b)->entry.name);
+}
+
+static uint64_t alignup(uint64_t offset)
+{
+  return (offset + SHADERARCHIVE_ALIGNMENT - 1) & ~(uint64_t)(SHADERARCHIVE_ALIGNMENT - 1);
+}
+
+int main(int argc, char **argv)
+{
+  if (argc < 3) {
+    fprintf(stderr, "Usage: %s <output> [name=]<shader.spv>...\n", argv[0]);
+    return 1;
+  }
+
+  uint32_t shaderCount = argc - 2;
+  PackedShader *shaders = calloc(shaderCount, sizeof(PackedShader));
+
+  for (uint32_t i = 0; i < shaderCount; i++) {
+    const char *path;
+    nameentry(argv[i + 2], shaders[i].entry.name, &path);
+
+    size_t size;
+    shaders[i].code = readfile(path, &size);
+    shaders[i].entry.codeSize = size;
+    if (!shaders[i].code || size % 4) {
+      fprintf(stderr, "Couldn't read SPIR-V from %s\n", path);
+      return 1;
+    }
+
+    if (!reflect(&shaders[i])) {
+      fprintf(stderr, "Couldn't reflect %s\n", path);
+      return 1;
+    }
+  }
+
+  qsort(shaders, shaderCount, sizeof(PackedShader), compareshaders);
+  for (uint32_t i = 1; i < shaderCount; i++) {
+    if (!strcmp(shaders[i].entry.name, shaders[i - 1].entry.name)) {
+      fprintf(stderr, "Duplicate shader name %s\n", shaders[i].entry.name);
+      return 1;
+    }
+  }
+
+  uint64_t offset = sizeof(ShaderArchiveHeader) + shaderCount * sizeof(ShaderArchiveEntry);
+  for (uint32_t i = 0; i < shaderCount; i++) {
+    shaders[i].entry.bindingOffset = offset;
+    offset += shaders[i].entry.bindingCount * sizeof(ShaderArchiveBinding);
+  }
+  for (uint32_t i = 0; i < shaderCount; i++) {
+    offset = alignup(offset);
+    shaders[i].entry.codeOffset = offset;
+    offset += shaders[i].entry.codeSize;
+  }
+
+  FILE *file = fopen(argv[1], "wb");
+  if (!file) {
+    fprintf(stderr, "Couldn't open %s for writing\n", argv[1]);
+    return 1;
+  }
+
+  ShaderArchiveHeader header = {
+    .magic = SHADERARCHIVE_MAGIC,
+    .version = SHADERARCHIVE_VERSION,
+    .entryCount = shaderCount,
+  };
+  fwrite(&header, sizeof(header), 1, file);
+
+  for (uint32_t i = 0; i < shaderCount; i++)
+    fwrite(&shaders[i].entry, sizeof(ShaderArchiveEntry), 1, file);
+
+  for (uint32_t i = 0; i < shaderCount; i++)
+    fwrite(shaders[i].bindings, sizeof(ShaderArchiveBinding), shaders[i].entry.bindingCount, file);
+
+  static const uint8_t padding[SHADERARCHIVE_ALIGNMENT] = { 0 };
+  for (uint32_t i = 0; i < shaderCount; i++) {
+    fwrite(padding, 1, shaders[i].entry.codeOffset - ftell(file), file);
+    fwrite(shaders[i].code, 1, shaders[i].entry.codeSize, file);
+  }
+
+  int failed = ferror(file);
+  fclose(file);
+
+  for (uint32_t i = 0; i < shaderCount; i++) {
+    free(shaders[i].code);
+    free(shaders[i].bindings);
+  }
+  free(shaders);
+
+  if (failed) {
+    fprintf(stderr, "Couldn't write %s\n", argv[1]);
+    return 1;
+  }
+  return 0;
+}